@@ -6,9 +6,19 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <vector>
 #include <stack>
 #include <fstream>
+#include <sstream>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <unistd.h>
 #include <math.h>				// Basic math functions
 #include "siteRP.h"
 #include "sg_connections.h"
@@ -29,6 +39,8 @@
         //debuginfo << "addedge function: ";
         //debuginfo << i << "\t" << j << std::endl;
         thegraph[i].push_back(j);
+        record(UNDO_ADDEDGE, i, j);
+        regionnum++;                            // the graph changed, so the marks findfreepebble left are out of date
         //listalledges();
     }
 
@@ -45,6 +57,8 @@
         for (int k = 0; k < thegraph[i].size(); k++) {
             if (thegraph[i].at(k) == j) {
                 thegraph[i].erase(thegraph[i].begin() + k);
+                record(UNDO_REMOVEEDGE, i, j, k);
+                regionnum++;
                 return 0;
             }
         }
@@ -93,18 +107,31 @@
 
 
 // finds the neighbor of a given site in a particular direction, either on a single SG (s=1) or on a lattice, in a SG lattice
+// The neighbors are looked up in the lattice table, which holds what DoEverything (or DoEverything_osg for s=1)
+// gives for every site and direction
     int SiteRP::choosedir_sg(int site, int d)
     {
-        int nb;
-        if(s == 1)
-        {
-            nb = DoEverything_osg(site, n, size, d);
+        if (neighbortable == nullptr) {
+            loadlattice();
         }
-        else
-        {
-            nb = DoEverything(site, n, s, size, d);
+        return neighbortable[6 * site + (d >= 1 && d <= 6 ? d : 6) - 1];
+    }
+
+    void SiteRP::loadlattice()
+    {
+        if (neighbortable != nullptr && lattice->header().order == lattice_order) {
+            return;
         }
-        return nb;
+        lattice = sharedlattice(n, s, size, lattice_cache, lattice_order);
+        neighbortable = lattice->neighbors();
+        tolegacy = lattice->legacy();
+        fromlegacy = lattice->site();
+        neighbormask = lattice->mask();
+        neighborcount = lattice->degree();
+        columnsknown = false;               // all three were worked out in the numbering before
+        blocksknown = 0;
+        occnearknown = false;
+        trialsitesknown = false;            // and the sites to reset were numbered the old way
     }
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -116,13 +143,19 @@
 
 // randprob() just returns a random number between zero and one.
     float SiteRP::randprob() {
+        rngdraws++;
         float f = rand();
         return f / RAND_MAX;
     }
 
-// randsite0 finds a random plaquette that may or may not be occupied
+// randsite0 finds a random plaquette that may or may not be occupied. The random number picks it by its layer by
+// layer number, so a trial goes the same way in any order of the sites
     int SiteRP::randsite0() {
-        return(rand() % size);
+        rngdraws++;
+        if (neighbortable == nullptr) {
+            loadlattice();
+        }
+        return fromlegacy[rand() % size];
     }
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -141,6 +174,7 @@
     void SiteRP::reversepath() {
         int starter = placesbeen.top();                // We start at the last place in the path, the site where we found a pebble
         pc[starter]--;                                // We remove a pebble from this site
+        record(UNDO_PEBBLE, starter, -1);
         placesbeen.pop();                            // We remove this site from our path, but it is still stored in starter
         int ender;
 
@@ -153,6 +187,7 @@
             placesbeen.pop();                        // and is removed from the path
         }
         pc[ender]++; // Finally, we add a pebble to the first site in the path, we've moved a pebble from the end to the start, reversing edges along the way
+        record(UNDO_PEBBLE, ender, 1);
         
         //std::ofstream debuginfo;
         //debuginfo.open("debug_output.txt", std::ios::app);
@@ -176,8 +211,10 @@
             return 0;
         }
         else {
-            bool beenthere[size] = {};            // We create an array to say whether we've been to these sites before (or should we create a global array and just set it to zero here?)
-            beenthere[i] = 1;                    // which we haven't, to start, except for our starting site (and any skip sites)
+            startsearch();                        // We start a new search, so no site has been visited yet
+            searchstamp[i] = searchnum;            // except for our starting site (and any skip sites)
+            searched.clear();
+            searched.push_back(i);
             placesbeen.push(i);                    // start our path at the starting site
             // cout << "Current location: " << placesbeen.top() << endl;
 
@@ -194,7 +231,7 @@
                 {
                     prosp = thegraph[cl].at(index1);                            // Our prospective location is one of the places we can go to from cl
                     //cout << "The prospective vertex we consider is " << prosp << endl;
-                    if (beenthere[prosp] == 0)                                    // if we haven't been there before...
+                    if (searchstamp[prosp] != searchnum)                          // if we haven't been there before...
                     {
                         // cl = prosp; // move our current location to there
                         //cout << "We are moving to " << prosp << endl;
@@ -205,7 +242,8 @@
 
                         if (pc[placesbeen.top()] > 0) { return 1; }                // If our new site has a pebble, quit looking for pebbles and say we found one
 
-                        beenthere[prosp] = 1;                                    // Otherwise mark it as having been visited, but keep looking for a pebble
+                        searchstamp[prosp] = searchnum;                            // Otherwise mark it as having been visited, but keep looking for a pebble
+                        searched.push_back(prosp);
                         //cout << "Current location is, in the for loop " << placesbeen.top() << endl;
 
                         break;                                                    // And break the for loop-- no point in continuing to explore cl's neighbors
@@ -240,9 +278,12 @@
             return 0;
         }
         else {
-            bool beenthere[size] = {};            // We create an array to say whether we've been to these sites before
-            beenthere[i] = 1;                    // which we haven't, to start, except for our starting site (and any skip sites)
-            beenthere[skip] = 1;
+            startsearch();                        // We start a new search, so no site has been visited yet
+            searchstamp[i] = searchnum;            // except for our starting site (and any skip sites)
+            searchstamp[skip] = searchnum;
+            searched.clear();
+            searched.push_back(i);
+            searched.push_back(skip);
             placesbeen.push(i);                    // start our path at the starting site
             // cout << "Current location: " << placesbeen.top() << endl;
 
@@ -260,7 +301,7 @@
                 {
                     prosp = thegraph[cl].at(index1);
                     //cout << "The prospective vertex we consider is " << prosp << endl;
-                    if (beenthere[prosp] == 0) // if we haven't been there before...
+                    if (searchstamp[prosp] != searchnum) // if we haven't been there before...
                     {
                         // cl = prosp; // move our current location to there
                         //cout << "We are moving to " << prosp << endl;
@@ -269,7 +310,8 @@
                         //cout << "Current location after pushing: " << placesbeen.top() << endl;
                         if (pc[placesbeen.top()] >
                             0) { return 1; }        // If our new site has a pebble, quit looking for pebbles
-                        beenthere[prosp] = 1;
+                        searchstamp[prosp] = searchnum;
+                        searched.push_back(prosp);
                         //cout << "Current location is, in the for loop " << placesbeen.top() << endl;
                         break;
                         /*
@@ -302,6 +344,75 @@
     }
 
 
+// startsearch gets the visit stamps ready for a new search, which saves clearing an array of every site each time
+    void SiteRP::startsearch() {
+        if (searchnum == std::numeric_limits<int>::max()) {
+            std::fill_n(searchstamp, size, 0);
+            searchnum = 0;
+        }
+        searchnum++;
+    }
+
+// findfreepebble looks for a pebble that could be moved onto i, not counting the ones on pin1 and pin2, but moves
+// nothing. With three pebbles pinned on a bond, i is rigid with the bond exactly when it can't find one.
+// Since no pebble moves, every site a failed search went through can't reach a free pebble either, and every
+// site on the path of a successful one can, so those sites get marked and later searches stop as soon as they
+// step on a marked site instead of going over the same region again. The marks hold until the graph changes or
+// other sites are pinned
+    bool SiteRP::findfreepebble(int i, int pin1, int pin2) {
+        if (placesbeen.size() > 0) {
+            std::cout << "I tried to find a free pebble, but the placesbeen stack wasn't empty, it had size " <<
+            placesbeen.size() << std::endl;
+            return 0;
+        }
+        if (pin1 != regionpin1 || pin2 != regionpin2) {    // marks found with other pebbles pinned don't count
+            regionnum++;
+            regionpin1 = pin1;
+            regionpin2 = pin2;
+        }
+        if (rigidmark[i] == regionnum) {
+            return 0;
+        }
+        startsearch();
+        searched.clear();
+        searchstamp[i] = searchnum;
+        searched.push_back(i);
+        placesbeen.push(i);
+        bool found = floppymark[i] == regionnum || (i != pin1 && i != pin2 && pc[i] > 0);
+
+        while (!found && placesbeen.size() > 0) {
+            int cl = placesbeen.top();
+            int index1 = 0;
+            for (; index1 < thegraph[cl].size(); index1++) {
+                int prosp = thegraph[cl][index1];
+                if (searchstamp[prosp] == searchnum || rigidmark[prosp] == regionnum) {
+                    continue;                    // been there, or known not to lead anywhere
+                }
+                searchstamp[prosp] = searchnum;
+                searched.push_back(prosp);
+                placesbeen.push(prosp);
+                found = floppymark[prosp] == regionnum || (prosp != pin1 && prosp != pin2 && pc[prosp] > 0);
+                break;
+            }
+            if (index1 == thegraph[cl].size()) { // nowhere left to go from cl, so retreat
+                placesbeen.pop();
+            }
+        }
+
+        if (found) {                            // the whole path leads to the pebble
+            while (placesbeen.size() > 0) {
+                floppymark[placesbeen.top()] = regionnum;
+                placesbeen.pop();
+            }
+        }
+        else {                                  // and nothing we went through does
+            for (int k = 0; k < searched.size(); k++) {
+                rigidmark[searched[k]] = regionnum;
+            }
+        }
+        return found;
+    }
+
 // loadsite looks for pebbles and moves them onto i until i has two pebbles or it stops finding pebbles
     bool SiteRP::loadsite(int i) {
         if (placesbeen.size() == 0) {
@@ -362,22 +473,377 @@
 
 // addbond tries to load the sites. If it succeeds, it adds an edge from i to j and takes a pebble from i. Otherwise, it adds a redundant edge
     void SiteRP::addbond(int i, int j) {
-        
+        if (span_test == SPAN_BUSBAR && !crossesseam(i, j)) {
+            openlattice.addbond(i, j);
+        }
+
         if (numbonds < 2 * size - 3 &&
             loadsites(i, j))            // If there are at least four pebbles left, we try to load the sites
         {
             pc[i]--;
+            record(UNDO_PEBBLE, i, -1);
             addedge(i, j);                // if we succeed, we add the edge from i to j and remove a pebble from i
             numbonds++;
             edges.push_back(Bond(i, j));
+            record(UNDO_BOND, i, j);
         }
         else {
+            markstressed(i, j);
             addedge(i, j);  //doing this just for the aesthetic purposes, the line below should be uncommented typically
             //addredundant(i, j);            // otherwise, we leave the pebbles where we shuffled them and
             rbonds++;
+            record(UNDO_REDUNDANT, i, j);
         }                                // place only a redundant bond
     }
 
+// When loadsites can't gather a fourth pebble on i and j, the last search it made went through every site it could
+// reach without finding a free pebble. Those sites, with i and j, are the smallest rigid region holding i and j,
+// and it already has as many independent bonds as it can (2 * sites - 3), so with the new bond all of its bonds
+// are overconstrained. Adding sites never relieves a stress, so the marks are only ever added to during a trial.
+// Only the sites the search went through and the bonds at them are looked at, so the work goes with the region
+    void SiteRP::markstressed(int i, int j) {
+        if (numbonds >= 2 * size - 3) {
+            loadsites(i, j);                    // addbond didn't try, so there is no failed search to go by yet
+        }
+        searchstamp[i] = searchnum;
+        searchstamp[j] = searchnum;
+        searched.push_back(i);
+        searched.push_back(j);
+        indexbonds();
+        for (int k = 0; k < searched.size(); k++) {
+            int site = searched[k];
+            if (stressed[site] == 0) {
+                stressed[site] = 1;
+                stressedsites++;
+                record(UNDO_STRESSEDSITE, site);
+            }
+            const vertex_t *nb = neighbortable + 6 * site;
+            for (int d = 0; d < 6; d++) {
+                vertex_t b = bondat[6 * site + d];
+                if (nb[d] == -1 || searchstamp[nb[d]] != searchnum || b < 0 || b >= vertex_t(bondsindexed)) {
+                    continue;
+                }
+                Bond &bond = edges[b];
+                if (!bond.stressed && ((bond.vertices.first == site && bond.vertices.second == nb[d]) ||
+                                       (bond.vertices.first == nb[d] && bond.vertices.second == site))) {
+                    bond.stressed = true;
+                    stressedbonds++;
+                    record(UNDO_STRESSEDBOND, int(b));
+                }
+            }
+        }
+    }
+
+    void SiteRP::indexbonds() {
+        for (; bondsindexed < edges.size(); bondsindexed++) {
+            int u = edges[bondsindexed].vertices.first;
+            int v = edges[bondsindexed].vertices.second;
+            for (int d = 0; d < 6; d++) {
+                if (neighbortable[6 * u + d] == v) {
+                    bondat[6 * u + d] = vertex_t(bondsindexed);
+                }
+                if (neighbortable[6 * v + d] == u) {
+                    bondat[6 * v + d] = vertex_t(bondsindexed);
+                }
+            }
+        }
+    }
+
+// Sites are numbered layer by layer, so each strip of SGs is a run of consecutive sites. Its layers are those of
+// the first strip but the top one, which it shares with the strip above, and the periodic bottom layer goes to the last
+    void SiteRP::findblocks(int numblocks) {
+        std::vector<int> vertices(3);
+        vertices[0] = 1;
+        vertices[1] = 2;
+        vertices[2] = 3;
+        SG_VertList(vertices, n);
+        SG_StripVertList(vertices, s);
+        int striplayers = int(vertices.size()) - 1;
+        if (neighbortable == nullptr) {
+            loadlattice();
+        }
+        const int32_t *layers = lattice->layer();
+
+        for (int site = 0; site < size; site++) {
+            int strip = layers[site] == 0 ? 0 : std::min(s - 1, (layers[site] - 1) / striplayers);
+            siteblock[site] = strip * numblocks / s;
+        }
+        blocksearches.resize(numblocks);
+        for (int b = 0; b < numblocks; b++) {
+            blocksearches[b].stamp.assign(size, 0);
+            blocksearches[b].num = 0;
+        }
+        blockpool.start(numblocks);
+        blocksknown = numblocks;
+    }
+
+    bool SiteRP::blockfindpebble(int i, int skip, int block, BlockSearch &search) {
+        if (search.num == std::numeric_limits<int>::max()) {
+            std::fill(search.stamp.begin(), search.stamp.end(), 0);
+            search.num = 0;
+        }
+        search.num++;
+        search.stamp[i] = search.num;
+        if (skip != -1) {
+            search.stamp[skip] = search.num;
+        }
+        search.path.assign(1, i);
+
+        while (search.path.size() > 0) {
+            int cl = search.path.back();
+            int index1 = 0;
+            for (; index1 < thegraph[cl].size(); index1++) {
+                int prosp = thegraph[cl][index1];
+                if (search.stamp[prosp] != search.num && siteblock[prosp] == block) {
+                    search.stamp[prosp] = search.num;
+                    search.path.push_back(prosp);
+                    break;
+                }
+            }
+            if (index1 == thegraph[cl].size()) {    // nowhere left to go from cl, so retreat
+                search.path.pop_back();
+            }
+            else if (pc[search.path.back()] > 0) {
+                // reverse the path like reversepath does, carrying the pebble back to i
+                int starter = search.path.back();
+                pc[starter]--;
+                for (int k = int(search.path.size()) - 2; k >= 0; k--) {
+                    int ender = search.path[k];
+                    thegraph[starter].push_back(ender);
+                    for (int m = 0; m < thegraph[ender].size(); m++) {
+                        if (thegraph[ender][m] == starter) {
+                            thegraph[ender].erase(thegraph[ender].begin() + m);
+                            break;
+                        }
+                    }
+                    starter = ender;
+                }
+                pc[i]++;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    bool SiteRP::blockloadsites(int i, int j, int block, BlockSearch &search) {
+        while (pc[j] < 2 && blockfindpebble(j, -1, block, search)) {
+        }
+        while (pc[i] < 2 && blockfindpebble(i, j, block, search)) {
+            while (pc[j] < 2 && blockfindpebble(j, -1, block, search)) {
+            }
+        }
+        return pc[i] == 2 && pc[j] == 2;
+    }
+
+// Each thread only ever touches the pebbles and edges of the sites of its own block, and the blocks' graphs
+// meet only through edges the searches don't follow, so the blocks can't get in each other's way. Moving
+// pebbles within a block is a legal move of the whole pebble game, so whatever a block loads is independent
+    void SiteRP::addbonds(const std::vector<std::pair<int, int> > &bonds) {
+        int numblocks = std::min(parallel_blocks, s);
+        if (numblocks < 2 || journaling) {
+            for (int k = 0; k < bonds.size(); k++) {
+                addbond(bonds[k].first, bonds[k].second);
+            }
+            return;
+        }
+        if (blocksknown != numblocks) {
+            findblocks(numblocks);
+        }
+
+        for (int b = 0; b < numblocks; b++) {
+            blocksearches[b].inside.clear();
+            blocksearches[b].placed.clear();
+            blocksearches[b].unplaced.clear();
+        }
+        std::vector<std::pair<int, int> > across;
+        for (int k = 0; k < bonds.size(); k++) {
+            if (siteblock[bonds[k].first] == siteblock[bonds[k].second]) {
+                blocksearches[siteblock[bonds[k].first]].inside.push_back(bonds[k]);
+            }
+            else {
+                across.push_back(bonds[k]);
+            }
+        }
+
+        blockpool.run([this](int b) {
+            BlockSearch &search = blocksearches[b];
+            for (int k = 0; k < search.inside.size(); k++) {
+                int i = search.inside[k].first;
+                int j = search.inside[k].second;
+                if (i != j && blockloadsites(i, j, b, search)) {
+                    pc[i]--;
+                    thegraph[i].push_back(j);
+                    search.placed.push_back(search.inside[k]);
+                }
+                else {
+                    search.unplaced.push_back(search.inside[k]);
+                }
+            }
+        });
+        regionnum++;                            // the blocks changed the graph behind the marks' back
+        published.reset();                      // and behind the pages' too
+
+        for (int b = 0; b < numblocks; b++) {
+            std::vector<std::pair<int, int> > &placed = blocksearches[b].placed;
+            for (int k = 0; k < placed.size(); k++) {
+                edges.push_back(Bond(placed[k].first, placed[k].second));
+                numbonds++;
+                if (span_test == SPAN_BUSBAR && !crossesseam(placed[k].first, placed[k].second)) {
+                    openlattice.addbond(placed[k].first, placed[k].second);
+                }
+            }
+        }
+        for (int b = 0; b < numblocks; b++) {       // pebbles from outside the block may still free these
+            std::vector<std::pair<int, int> > &unplaced = blocksearches[b].unplaced;
+            for (int k = 0; k < unplaced.size(); k++) {
+                addbond(unplaced[k].first, unplaced[k].second);
+            }
+        }
+        for (int k = 0; k < across.size(); k++) {
+            addbond(across[k].first, across[k].second);
+        }
+    }
+
+// A bond goes from the later of its two sites in the batch to the earlier, as it would have if they had been
+// placed one by one
+    void SiteRP::placebatch() {
+        if (batch.empty()) {
+            return;
+        }
+        if (batchposition.empty()) {
+            batchposition.assign(size, -1);
+        }
+        for (int k = 0; k < batch.size(); k++) {
+            batchposition[batch[k]] = k;
+        }
+        std::vector<std::pair<int, int> > bonds;
+        for (int k = 0; k < batch.size(); k++) {
+            int site = batch[k];
+            for (int d = 1; d <= 6; d++) {
+                int newsite = choosedir_sg(site, d);
+                if (newsite != -1 && occ[newsite] == 1 && batchposition[newsite] < k) {
+                    bonds.push_back(std::make_pair(site, newsite));
+                }
+            }
+        }
+        for (int k = 0; k < batch.size(); k++) {
+            batchposition[batch[k]] = -1;
+        }
+        batch.clear();
+        std::sort(bonds.begin(), bonds.end());      // a neighbor in two directions is still one bond
+        bonds.erase(std::unique(bonds.begin(), bonds.end()), bonds.end());
+        addbonds(bonds);
+    }
+
+    void SiteRP::rebuildbyblocks() {
+        numbonds = 0;
+        rbonds = 0;
+        stressedsites = 0;
+        stressedbonds = 0;
+        edges.clear();
+        bondsindexed = 0;
+        batch.clear();
+        for (int site = 0; site < size; site++) {
+            pc[site] = 2;
+            stressed[site] = 0;
+            thegraph[site].clear();
+            rgraph[site].clear();
+        }
+        regionnum++;
+        endjournal();
+        published.reset();
+        if (span_test == SPAN_BUSBAR) {
+            buildopenlattice();
+        }
+
+        std::vector<std::pair<int, int> > bonds;
+        for (int site = 0; site < size; site++) {
+            for (int d = 1; d <= 6 && occ[site] == 1; d++) {
+                int newsite = choosedir_sg(site, d);
+                if (newsite != -1 && occ[newsite] == 1 && newsite < site) {
+                    bonds.push_back(std::make_pair(site, newsite));
+                }
+            }
+        }
+        std::sort(bonds.begin(), bonds.end());
+        bonds.erase(std::unique(bonds.begin(), bonds.end()), bonds.end());
+        addbonds(bonds);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// UNDO JOURNAL
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    int SiteRP::mark() {
+        journaling = true;
+        return int(journal.size());
+    }
+
+// Every change is undone in the state right after it was made, so an added edge is still the last one of its site
+// and a removed one goes back where it was, which leaves the graph exactly as it was, down to the order of edges
+    void SiteRP::rollback(int m) {
+        while (journal.size() > m) {
+            Change c = journal.back();
+            journal.pop_back();
+            switch (c.kind) {
+                case UNDO_PEBBLE:
+                    pc[c.i] -= c.j;
+                    break;
+                case UNDO_ADDEDGE:
+                    thegraph[c.i].pop_back();
+                    break;
+                case UNDO_REMOVEEDGE:
+                    thegraph[c.i].insert(thegraph[c.i].begin() + c.k, c.j);
+                    break;
+                case UNDO_BOND:
+                    edges.pop_back();
+                    bondsindexed = std::min(bondsindexed, edges.size());
+                    numbonds--;
+                    break;
+                case UNDO_REDUNDANT:
+                    rbonds--;
+                    break;
+                case UNDO_OCCUPY:
+                    occ[c.i] = 0;
+                    markneighbors(c.i, false);
+                    numparts--;
+                    break;
+                case UNDO_STRESSEDSITE:
+                    stressed[c.i] = 0;
+                    stressedsites--;
+                    break;
+                case UNDO_STRESSEDBOND:
+                    edges[c.i].stressed = false;
+                    stressedbonds--;
+                    break;
+            }
+        }
+        regionnum++;                        // the free pebble marks belonged to the graph before the rollback
+        batch.clear();                      // any site still waiting for its bonds was placed after the mark
+        published.reset();                  // and the pages of the last snapshot can't be told apart from the ones changed back
+        if (span_test == SPAN_BUSBAR) {
+            buildopenlattice();
+        }
+    }
+
+    void SiteRP::endjournal() {
+        journaling = false;
+        journal.clear();
+    }
+
+    bool SiteRP::wouldberedundant(int i, int j) {
+        bool wasjournaling = journaling;
+        int m = mark();
+        bool redundant = numbonds >= 2 * size - 3 || !loadsites(i, j) || i == j;
+        rollback(m);
+        journaling = wasjournaling;
+        return redundant;
+    }
+
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -386,7 +852,7 @@
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    void SiteRP::setfilestream(float cval, int tval) {
+    void SiteRP::setfilestream(float cval, int tval, bool append) {
 
 
         char mychar[] = "./data/cxxxtxxxx.txt";
@@ -414,17 +880,31 @@
         mychar_rcluster[start_rcluster + 1] = '0' + (intc % 100) / 10;
         mychar_rcluster[start_rcluster + 2] = '0' + (intc % 10);
 
+        trialnum = tval;
+        std::ios::openmode mode = append ? std::ios::app : std::ios::out;
+
+        myfilename = mychar;
+        rclusterfilename = mychar_rcluster;
+
         myfile.close();
-        myfile.open(mychar);
+        myfile.open(mychar, mode);
 
         rclusterfile.close();
-        rclusterfile.open(mychar_rcluster);
+        rclusterfile.open(mychar_rcluster, mode);
 
         //cout << mychar;
     }
 
     void SiteRP::log(int span) {
-        myfile << ll << "\t" << correlation << "\t" << numparts << "\t" << numbonds << "\t" << rbonds << "\t" <<
+        if (!pendingchecks.empty()) {       // the lines of the checks in flight go first
+            heldlines.push_back(HeldLine{numparts, numbonds, rbonds});
+            return;
+        }
+        logline(numparts, numbonds, rbonds, span);
+    }
+
+    void SiteRP::logline(int parts, int bonds, int redundant, int span) {
+        myfile << ll << "\t" << correlation << "\t" << parts << "\t" << bonds << "\t" << redundant << "\t" <<
         giantsize_bond << "\t" << giantsize_site << "\t" << span << "\n";
     }
 
@@ -480,41 +960,103 @@
         giantsize_bond = 0;
 
         // rewrite the RigidIndex for edges
-        for (std::vector<Bond>::iterator it = edges.begin(); it != edges.end(); ++it) {
+        for (Bond * it = edges.begin(); it != edges.end(); ++it) {
             it->initBondRigidIndex();
         }
 
+        if (trialsitesknown) {                  // the giant cluster is made of occupied sites
+            for (int k = 0; k < trialsites.size(); k++) {
+                giantrigidcluster[trialsites[k]].clear();
+            }
+            return;
+        }
         for (int bondindex = 0; bondindex < size; bondindex++)  // Clear the graphs of giantrigidcluster
         {
             giantrigidcluster[bondindex].clear();
         }
     }
 
+    void SiteRP::clearsite(int site) {
+        pc[site] = 2;
+        occ[site] = 0;
+        stressed[site] = 0;
+        rgraph[site].clear();
+        thegraph[site].clear();
+        giantrigidcluster[site].clear();
+        occnear[site] = 0;
+        const vertex_t *nb = neighbortable + 6 * site;
+        for (int d = 0; d < 6; d++) {
+            if (nb[d] != -1) {
+                occnear[nb[d]] = 0;             // every occupied neighbor it had was occupied this trial too
+            }
+        }
+    }
+
 // initemptytrigraph() updates numbonds, rbonds, thegraph, rgraph, placesbeen to a triangular graph with no particles or bonds
     int SiteRP::initemptytrigraph() {
+        loadlattice();
+        if (out_of_core && !sitestore.isfile()) {
+            sitestore.tofile("sites_n" + std::to_string(n) + "s" + std::to_string(s) + "_" + std::to_string(getpid()) + ".bin");
+        }
+        else if (!out_of_core && sitestore.isfile()) {
+            sitestore.tomemory();
+        }
         numbonds = 0; // the number of bonds
         edges.clear();
+        bondsindexed = 0;
         numparts = 0; // the number of particles
         rbonds = 0;   // the number of redundant bonds
+        stressedsites = 0;
+        stressedbonds = 0;
         SpanLastStatus = 0; // the initial spanning status is NO
+        flag_for_span_check = 0;
+        critical_pc = -1;
+
+        if (trialsitesknown && occnearknown) {  // only the sites the last trial occupied have anything on them
+            for (int k = 0; k < trialsites.size(); k++) {
+                clearsite(trialsites[k]);
+            }
+        }
+        else {
+            for (int pcindex = 0; pcindex < size; pcindex++) // Just setting the pebble count to 2 everywhere.
+            {                                               // and setting which sites are occupied
+                pc[pcindex] = 2;
+                occ[pcindex] = 0;
+                stressed[pcindex] = 0;
+            }
+
+            for (int bondindex = 0; bondindex < size; bondindex++)  // Clear the graphs of redundant and nonredundant bonds
+            {
+                rgraph[bondindex].clear();
+                thegraph[bondindex].clear();
+                giantrigidcluster[bondindex].clear();
 
-        for (int pcindex = 0; pcindex < size; pcindex++) // Just setting the pebble count to 2 everywhere.
-        {                                               // and setting which sites are occupied
-            pc[pcindex] = 2;
-            occ[pcindex] = 0;
+            }
+            std::fill_n(occnear, size, 0);               // No neighbor of any site is occupied
         }
+        trialsites.clear();
+        trialsitesknown = true;
+        occnearknown = true;
 
         while (placesbeen.size() > 0)                    // Clear the places been stack
         {
             placesbeen.pop();
         }
 
-        for (int bondindex = 0; bondindex < size; bondindex++)  // Clear the graphs of redundant and nonredundant bonds
-        {
-            rgraph[bondindex].clear();
-            thegraph[bondindex].clear();
-            giantrigidcluster[bondindex].clear();
-
+        if (regionnum > std::numeric_limits<int>::max() / 2) {
+            std::fill_n(rigidmark, size, 0);             // Forget what the free pebble searches found
+            std::fill_n(floppymark, size, 0);
+            regionnum = 0;
+        }
+        regionnum++;                            // which leaves every mark of the last trial out of date
+        regionpin1 = -1;
+        regionpin2 = -1;
+        giantseed = -1;
+        batch.clear();
+        endjournal();
+        newepoch(0);
+        if (span_test == SPAN_BUSBAR) {
+            buildopenlattice();
         }
         initgiantrigidcluster();
         return numparts;
@@ -523,121 +1065,212 @@
 // The original addtricluster2 function from Shang and Zeb's original pebble game code has been modified to work for an SG lattice
     void SiteRP::addtricluster2_sg(int site, float c) // Has already added the rigidcluster function, as well as the spanning cluster
     {
-        int total_neighbors;
-        int numneighbors;
-        
         if (occ[site] == 0) {
-            int newsite;
-            //identifies the type of vertex site is and uses that to determine neighbors 
-            //Type 2 vertex
-            if (choosedir_sg(site, 1) == -1 && choosedir_sg(site, 2) == -1)
-            {
-                total_neighbors = 4;
-                numneighbors = occ[choosedir_sg(site, 3)] + occ[choosedir_sg(site, 4)] + occ[choosedir_sg(site, 5)] + occ[choosedir_sg(site, 6)];
+            //the type of vertex site is only shows in which of its neighbors are there, which accepted() reads off a mask
+            if (accepted(site, c)) {
+                std::ofstream occsites;
+                occsites.open("mathematica_occsites_from_pebble.txt", std::ios::app);
+                occsites << tolegacy[site] + 1 << std::endl;
+
+                placesite(site);
+                if (record_sequence) {
+                    sequence.push_back(tolegacy[site]);
+                }
+                checkspan(c);
             }
-            
-            //Type 4 vertex
-            else if (choosedir_sg(site, 3) == -1 && choosedir_sg(site, 4) == -1)
-            {
-                total_neighbors = 4;
-                numneighbors = occ[choosedir_sg(site, 1)] + occ[choosedir_sg(site, 2)] + occ[choosedir_sg(site, 5)] + occ[choosedir_sg(site, 6)];
+        }
+    }
+
+    bool SiteRP::accepted(int site, float c) {
+        if (!occnearknown) {
+            findoccnear();
+        }
+        if (c != acceptancec) {
+            for (int k = 0; k <= 6; k++) {
+                acceptance[k] = pow(1. - c, k);
             }
-            
-            //Type 3 vertex
-            else if (choosedir_sg(site, 5) == -1 && choosedir_sg(site, 6) == -1)
-            {
-                total_neighbors = 4;
-                numneighbors = occ[choosedir_sg(site, 1)] + occ[choosedir_sg(site, 2)] + occ[choosedir_sg(site, 3)] + occ[choosedir_sg(site, 4)];
+            acceptancec = c;
+        }
+        int emptyneighbors = neighborcount[site] - __builtin_popcount(occnear[site]);
+        return randprob() < acceptance[emptyneighbors];
+    }
+
+// the neighbor of site in direction d sees site in the opposite direction, d + 3 around the six
+    void SiteRP::markneighbors(int site, bool occupied) {
+        const vertex_t *nb = neighbortable + 6 * site;
+        for (int d = 0; d < 6; d++) {
+            if (nb[d] == -1) {
+                continue;
             }
-            
-            //Type 1 vertex
-            else
-            {
-                total_neighbors = 6;
-                numneighbors = occ[choosedir_sg(site, 1)] + occ[choosedir_sg(site, 2)] + occ[choosedir_sg(site, 3)] + occ[choosedir_sg(site, 4)] + occ[choosedir_sg(site, 5)] + occ[choosedir_sg(site, 6)];
+            uint8_t bit = uint8_t(1 << ((d + 3) % 6));
+            occnear[nb[d]] = occupied ? occnear[nb[d]] | bit : occnear[nb[d]] & ~bit;
+        }
+    }
+
+    void SiteRP::findoccnear() {
+        loadlattice();
+        std::fill_n(occnear, size, 0);
+        for (int site = 0; site < size; site++) {
+            if (occ[site] != 0) {
+                markneighbors(site, true);
             }
-            
-            if (randprob() < pow(1. - c, total_neighbors - numneighbors)) {
-                occ[site] = 1;
-                
-                std::ofstream occsites;
-                occsites.open("mathematica_occsites_from_pebble.txt", std::ios::app);
-                occsites << site + 1 << std::endl;
-                numparts++;
-                for (int k = 1; k <= 6; k++) {
-                    newsite = choosedir_sg(site, k);
-                    
-                    if (occ[newsite] == 1 && isempty(site, newsite) && newsite != -1) {
-                        addbond(site, newsite);
-                    }
-                }
-                
-                double span_check_start;
-                //saves time by checking for a spanning rigid cluster only after the 
-		//lattice is sufficiently populated. These lower bounds are only written
-		//for up to n=5, the default is no lower bound. 
-                switch(n)
-                {
-                    case 1:
-                        span_check_start = 0.73;
-                        break;
-                    case 2:
-                        span_check_start = 0.83;
-                        break;
-                    case 3:
-                        span_check_start = 0.91;
-                        break;
-                    case 4:
-                        span_check_start = 0.96;
-                        break;
-                    case 5:
-                        span_check_start = 0.99;
-                        break;
-                    default:
-                        span_check_start = 0.0;
-                        break;
-                }
-               //another time saving feature so that the spanning rigid cluster is not
-	       //checked after every single site 
-                int check_every = size * 1.0/256;
-                //int check_every = 1;
-                
-                if(check_every == 0)
-                {
-                    check_every = 1;
+        }
+        occnearknown = true;
+    }
+
+// placesite occupies site and adds the bonds to its occupied neighbors, with no acceptance test
+    void SiteRP::placesite(int site) {
+        occ[site] = 1;
+        markneighbors(site, true);
+        trialsites.push_back(site);
+        numparts++;
+        record(UNDO_OCCUPY, site);
+        if (parallel_blocks > 1 && !journaling) {
+            batch.push_back(site);
+            return;
+        }
+        for (int k = 1; k <= 6; k++) {
+            int newsite = choosedir_sg(site, k);
+
+            if (newsite != -1 && occ[newsite] == 1 && isempty(site, newsite)) {
+                addbond(site, newsite);
+            }
+        }
+    }
+
+// checkspan decomposes the network into rigid clusters once it is dense enough, and records pc when it first spans
+    void SiteRP::checkspan(float c) {
+        double span_check_start;
+        //saves time by checking for a spanning rigid cluster only after the 
+        //lattice is sufficiently populated. These lower bounds are only written
+        //for up to n=5, the default is no lower bound. 
+        switch(n)
+        {
+            case 1:
+                span_check_start = 0.73;
+                break;
+            case 2:
+                span_check_start = 0.83;
+                break;
+            case 3:
+                span_check_start = 0.91;
+                break;
+            case 4:
+                span_check_start = 0.96;
+                break;
+            case 5:
+                span_check_start = 0.99;
+                break;
+            default:
+                span_check_start = 0.0;
+                break;
+        }
+        //another time saving feature so that the spanning rigid cluster is not
+        //checked after every single site 
+        int check_every = size * 1.0/256;
+        //int check_every = 1;
+        
+        if(check_every == 0)
+        {
+            check_every = 1;
+        }
+        
+        // choose some densities for the rigid cluster
+        if (numparts % check_every == 0 && double(numparts)/size > span_check_start) {
+            placebatch();
+            if (async_span) {
+                submitcheck(c);
+                return;
+            }
+            int span = findspan();
+            log(span); // choose the critical position to get rigid cluster decomposition 
+            if (SpanLastStatus == 0 && span == 1){ 
+                recordcritical(c);
+            }
+        
+            // update the SpanLastStatus
+            SpanLastStatus = span;
+        }
+        else
+            log();
+    }
+
+// With SPAN_BUSBAR the bus bar test takes the place of the decomposition at every check, and the clusters are found
+// only once the bars hold, for the backbone and cluster statistics recordcritical() writes at pc
+    int SiteRP::findspan() {
+        int span;
+        if (span_test == SPAN_BUSBAR) {
+            span = busbarspan();
+            if (span && SpanLastStatus == 0) {
+                if (use_hierarchy) {
+                    hierarchicalrcluster();
                 }
-                
-                // choose some densities for the rigid cluster
-                if (numparts % check_every == 0 && double(numparts)/size > span_check_start) {
+                else {
                     rigidcluster();
-                
-                    int span = spanningrcluster();
-                    log(span); // choose the critical position to get rigid cluster decomposition 
-		    if (SpanLastStatus == 0 && span == 1){ 
-			StoreRigidInfoOfSite();
-                        
-                        //critical packing fraction
-                        double pc = double(numparts)/size;
-                        
-                        //critical volume density, output to file
-                        double phi = 2 * numparts * (0.25) * (M_PI)/(ll * ll * sqrt(3));
-                        
-                        std::ofstream vals;
-                        vals.open("pc_and_phi_n" + std::to_string(n) + "s" + std::to_string(s) + ".txt", std::ios::app);
-                        vals << std::fixed << std::showpoint;
-                        vals << std::setprecision(6) << pc << " " << phi << std::endl;
-                        vals.close();
-                        std::cout << "The critical packing fraction is " << pc << std::endl;
-                        flag_for_span_check = 1;
-                    }
-                
-                    // update the SpanLastStatus
-                    SpanLastStatus = span;
                 }
-                else
-                    log();
             }
         }
+        else if (use_hierarchy) {
+            span = hierarchicalrcluster();
+        }
+        else if (giant_only) {
+            span = seamrcluster();
+            if (span && SpanLastStatus == 0) {  // make sure it is the giant cluster that spans, as the statistics at pc need every cluster anyway
+                rigidcluster();
+                span = spanningrcluster();
+            }
+        }
+        else {
+            rigidcluster();
+            span = spanningrcluster();
+        }
+        return span;
+    }
+
+    void SiteRP::recordcritical(float c) {
+        StoreRigidInfoOfSite();
+        
+        //critical packing fraction
+        double pc = double(numparts)/size;
+        
+        //critical volume density, output to file
+        double phi = 2 * numparts * (0.25) * (M_PI)/(ll * ll * sqrt(3));
+        
+        std::ofstream vals;
+        vals.open(pcphiname(), std::ios::app);
+        vals << std::fixed << std::showpoint;
+        vals << std::setprecision(6) << pc << " " << phi << std::endl;
+        vals.close();
+
+        //stressed backbone, the overconstrained part of the spanning cluster, marked as the sites were added
+        int backbone = 0;
+        for (int site = 0; site < size; site++) {
+            if (stressed[site] != 0 && !giantrigidcluster[site].empty()) {
+                backbone++;
+            }
+        }
+        std::ofstream bb;
+        bb.open(backbonename(), std::ios::app);
+        bb << std::fixed << std::showpoint;
+        bb << std::setprecision(6) << pc << " " << backbone << " " << stressedsites << " " << stressedbonds + rbonds << std::endl;
+        bb.close();
+        pcstats.add(n, s, c, pc, phi);
+        PcStats::Entry &sizes = pcstats.entry(n, s, c);
+        for (int k = 1; k <= clusters.numclusters; k++) {    // the finite clusters, for n_s
+            if (k != giantindex) {
+                sizes.clustersites.add(clusters.sites[k]);
+                sizes.clusterbonds.add(clusters.bonds[k]);
+            }
+        }
+        critical_pc = pc;
+        if (snapshot_at_pc) {
+            savesnapshot(snapshotname(c, trialnum));
+        }
+        if (picture_at_pc) {
+            savepicture(picturename(c, trialnum));
+        }
+        std::cout << "The critical packing fraction is " << pc << std::endl;
+        flag_for_span_check = 1;
     }
 
     void SiteRP::onetritrial2(long long int maxout, float c) {
@@ -649,108 +1282,1439 @@
             addtricluster2_sg(randsite0(), c);
             //plot();
         }
+        placebatch();
+        if (async_span) {
+            collectchecks(c, 0);
+        }
 
         myfile.close();
         rclusterfile.close();
     }
 
-    void SiteRP::multictrial(long long int maxout, float c1, float c2, float dc, int numtrials) {
+    void SiteRP::multictrial(long long int maxout, float c1, float c2, float dc, int numtrials, bool resume) {
+        std::vector<float> cvals;
         for (correlation = c1; correlation <= c2; correlation += dc) {
-            for (int mtc = 14; mtc <= numtrials; mtc++) {
-                int numattempts = 0;
-                initemptytrigraph();
+            cvals.push_back(correlation);
+        }
+
+        // job k is trial k % numtrials + 1 at the correlation value cvals[k / numtrials]
+        int numjobs = int(cvals.size()) * numtrials;
+        sweep.c1 = c1;
+        sweep.c2 = c2;
+        sweep.dc = dc;
+        sweep.numtrials = numtrials;
+        sweep.jobdone.assign(numjobs, 0);
+        sweep.job = -1;
+
+        int resumejob = -1;                     // the trial that was in flight when the checkpoint was taken
+        if (checkpoint_interval > 0) {
+            sweepseed = rand();
+            if (resume && readcheckpoint()) {
+                int numdone = 0;
+                for (int job = 0; job < numjobs; job++) {
+                    numdone += sweep.jobdone[job];
+                }
+                std::cout << "Resuming the sweep with " << numdone << " of " << numjobs << " trials already done." << std::endl;
+                resumejob = sweep.job;
+                cutoutputs(false);              // drop the lines of the trials done after the checkpoint, which run again
+
+            }
+        }
+        sweep.lastcheckpoint = time(NULL);
+
+        // the trial in flight continues from its saved engine state, replaying the same number of draws
+        // from the job's stream puts the random numbers back where they were too. readcheckpoint has made sure
+        // the snapshot is the one taken with the checkpoint; if it still can't be loaded the job is left for the
+        // loop below to redo from the start. A recorded sequence isn't part of the snapshot, so with
+        // record_sequence trials are only checkpointed between them
+        if (resumejob >= 0 && !record_sequence) {
+            long long attempts = sweep.numattempts;
+            if (loadsnapshot(checkpointname() + ".snap")) {
+                correlation = cvals[resumejob / numtrials];
+                long long draws = rngdraws;
+                srand(sweepseed + resumejob);
+                for (long long k = 0; k < draws; k++) {
+                    rand();
+                }
+                rngdraws = draws;
+                sweep.job = resumejob;
+                sweep.numattempts = attempts;
+                setfilestream(correlation, resumejob % numtrials + 1, true);
+                cutoutputs(true);
+                deposit(maxout, correlation, false);
+                sweep.jobdone[resumejob] = 1;
+            }
+            sweep.job = -1;
+        }
+
+        for (int job = 0; job < numjobs; job++) {
+            if (sweep.jobdone[job]) {
+                continue;
+            }
+            correlation = cvals[job / numtrials];
+
+            // each job gets its own stream, so a resumed sweep redoes an interrupted trial exactly
+            if (checkpoint_interval > 0) {
+                srand(sweepseed + job);
+                rngdraws = 0;
+            }
+            sweep.job = job;
+            onectrial(maxout, correlation, job % numtrials + 1, false);
+            sweep.jobdone[job] = 1;
+            sweep.job = -1;
+
+            if (checkpoint_interval > 0 && time(NULL) - sweep.lastcheckpoint >= checkpoint_interval) {
+                writecheckpoint();
+            }
+        }
+
+        // fold this run's pc statistics into the summary on disk, which may already hold other runs or workers
+        pcstats.mergeintofile(summaryname());
+        pcstats.clear();
+
+        if (checkpoint_interval > 0) {
+            remove(checkpointname().c_str());
+            remove((checkpointname() + ".snap").c_str());
+        }
+    }
+
+    double SiteRP::onectrial(long long int maxout, float c, int trial, bool stopatspan) {
+        initemptytrigraph();
+        FaultCount before = FaultCount::now();
+
+        setfilestream(c, trial);
+
+        sequence.clear();
+        sweep.numattempts = 0;
+        deposit(maxout, c, stopatspan);
+        if (record_sequence) {
+            writesequence(sequencename(c, trial));
+        }
+        if (out_of_core) {
+            FaultCount after = FaultCount::now();
+            std::ofstream faults(faultsname(), std::ios::app);
+            faults << c << " " << trial << " " << critical_pc << " " << numparts << " " << after.minor - before.minor
+                   << " " << after.major - before.major << std::endl;
+        }
+        return critical_pc;
+    }
+
+    void SiteRP::deposit(long long int maxout, float c, bool stopatspan) {
+        do {
+            while (sweep.numattempts < maxout && numparts < size && (!stopatspan || flag_for_span_check == 0)) {
+                sweep.numattempts++;
+
+                addtricluster2_sg(randsite0(), c);
+
+                // long trials are checkpointed from the inside, with the engine state of the trial saved alongside
+                if (checkpoint_inflight && !record_sequence && checkpoint_interval > 0 && sweep.job >= 0 &&
+                    sweep.numattempts % 1024 == 0 &&
+                    time(NULL) - sweep.lastcheckpoint >= checkpoint_interval) {
+                    if (async_span) {
+                        collectchecks(c, 0);    // the snapshot can't be taken with checks in flight
+                    }
+                    writecheckpoint();
+                }
+            }
+            placebatch();
+            // the checks still in flight may take the trial back to its critical point, and it carries on from there
+        } while (async_span && collectchecks(c, 0));
+    }
+
+    void SiteRP::adaptivectrial(long long int maxout, float c1, float c2, float dc, int mintrials, int maxtrials, double target_se) {
+        std::vector<float> cvals;                   // the same correlation values multictrial would visit
+        for (correlation = c1; correlation <= c2; correlation += dc) {
+            cvals.push_back(correlation);
+        }
+        std::vector<int> trials(cvals.size(), 0);   // trials run so far at each correlation value
+
+        while (true) {
+            // every point first gets its mintrials, after that the trial goes to the unconverged
+            // point whose standard error is furthest above the target
+            int next = -1;
+            double worst = 0;
+            for (int k = 0; k < cvals.size(); k++) {
+                if (trials[k] >= maxtrials) {
+                    continue;
+                }
+                double se = pcstats.entry(n, s, cvals[k]).pc.stderror();
+                double priority = (trials[k] < mintrials) ? HUGE_VAL : se / target_se;
+                if (priority > 1 && (next == -1 || priority > worst)) {
+                    next = k;
+                    worst = priority;
+                }
+            }
+            if (next == -1) {
+                break;
+            }
+
+            correlation = cvals[next];
+            trials[next]++;
+            onectrial(maxout, correlation, trials[next], true);
+        }
+
+        std::ofstream report;
+        report.open("adaptive_n" + std::to_string(n) + "s" + std::to_string(s) + spantag() + ".txt", std::ios::app);
+        report << std::fixed << std::showpoint;
+        for (int k = 0; k < cvals.size(); k++) {
+            Moments &m = pcstats.entry(n, s, cvals[k]).pc;
+            report << std::setprecision(6) << cvals[k] << "\t" << trials[k] << "\t" << m.count << "\t" << m.mean << "\t"
+                   << m.stderror() << "\t" << (m.stderror() <= target_se) << "\n";
+        }
+        report.close();
+
+        pcstats.mergeintofile(summaryname());
+        pcstats.clear();
+    }
+
+    std::string SiteRP::summaryname() {
+        return "pc_summary_n" + std::to_string(n) + "s" + std::to_string(s) + spantag() + ".txt";
+    }
+
+    std::string SiteRP::pcphiname() {
+        return "pc_and_phi_n" + std::to_string(n) + "s" + std::to_string(s) + spantag() + ".txt";
+    }
+
+    std::string SiteRP::backbonename() {
+        return "backbone_n" + std::to_string(n) + "s" + std::to_string(s) + spantag() + ".txt";
+    }
+
+    std::string SiteRP::faultsname() {
+        return "faults_n" + std::to_string(n) + "s" + std::to_string(s) + ".txt";
+    }
+
+    std::string SiteRP::spantag() {
+        return span_test == SPAN_BUSBAR ? "_busbar" : "";
+    }
+
+    std::string SiteRP::checkpointname() {
+        return "checkpoint_n" + std::to_string(n) + "s" + std::to_string(s) + spantag() + ".txt";
+    }
+
+// the length of an output file, or -1 if it isn't there yet
+    static long long outputlength(const std::string &filename) {
+        std::error_code err;
+        std::uintmax_t length = std::filesystem::file_size(filename, err);
+        return err ? -1 : (long long) length;
+    }
+
+// cuts an output file back to the length it had at the checkpoint, so the lines a resumed trial writes again aren't doubled
+    static void cutoutput(const std::string &filename, long long length) {
+        std::error_code err;
+        if (length >= 0 && outputlength(filename) > length) {
+            std::filesystem::resize_file(filename, length, err);
+        }
+    }
+
+    void SiteRP::cutoutputs(bool inflight) {
+        cutoutput(pcphiname(), sweep.outputbytes[2]);
+        cutoutput("mathematica_occsites_from_pebble.txt", sweep.outputbytes[3]);
+        cutoutput(backbonename(), sweep.outputbytes[4]);
+        if (!inflight) {
+            return;
+        }
+        myfile.close();
+        rclusterfile.close();
+        cutoutput(myfilename, sweep.outputbytes[0]);
+        cutoutput(rclusterfilename, sweep.outputbytes[1]);
+        myfile.open(myfilename, std::ios::app);
+        rclusterfile.open(rclusterfilename, std::ios::app);
+    }
+
+    bool SiteRP::writecheckpoint() {
+        sweep.lastcheckpoint = time(NULL);
+
+        // the files the whole sweep appends to are measured at every checkpoint, so the trials a resumed sweep
+        // runs again can't write their lines twice. A trial's own two files only matter while it is in flight
+        sweep.outputbytes[0] = -1;
+        sweep.outputbytes[1] = -1;
+        sweep.outputbytes[2] = outputlength(pcphiname());
+        sweep.outputbytes[3] = outputlength("mathematica_occsites_from_pebble.txt");
+        sweep.outputbytes[4] = outputlength(backbonename());
+
+        // a trial in flight is written first, so the checkpoint that refers to it never exists without it
+        bool inflight = checkpoint_inflight && sweep.job >= 0;
+        if (inflight) {
+            myfile.flush();
+            rclusterfile.flush();
+            sweep.outputbytes[0] = outputlength(myfilename);
+            sweep.outputbytes[1] = outputlength(rclusterfilename);
+
+            std::string snapname = checkpointname() + ".snap";
+            if (!savesnapshot(snapname + ".tmp") || rename((snapname + ".tmp").c_str(), snapname.c_str()) != 0) {
+                std::cout << "I couldn't save the trial in flight, so the previous checkpoint is kept.\n";
+                return 0;
+            }
+        }
+
+        std::string tmpname = checkpointname() + ".tmp";
+        std::ofstream out(tmpname);
+        if (!out) {
+            std::cout << "I couldn't open " << tmpname << " to write a checkpoint.\n";
+            return 0;
+        }
+
+        out << "# sweep checkpoint v2\n";
+        out << std::setprecision(9);
+        out << "lattice " << n << " " << s << " " << size << "\n";
+        out << "sweep " << sweep.c1 << " " << sweep.c2 << " " << sweep.dc << " " << sweep.numtrials << "\n";
+        out << "seed " << sweepseed << "\n";
+        out << "jobs " << sweep.jobdone.size();
+        for (int job = 0; job < sweep.jobdone.size(); job++) {
+            out << " " << int(sweep.jobdone[job]);
+        }
+        out << "\n";
+        if (inflight) {
+            out << "inflight " << sweep.job << " " << sweep.numattempts << " " << rngdraws << "\n";
+        }
+        else {
+            out << "inflight -1 0 0\n";
+        }
+        out << "outputs " << sweep.outputbytes[0] << " " << sweep.outputbytes[1] << " " << sweep.outputbytes[2] << " "
+            << sweep.outputbytes[3] << " " << sweep.outputbytes[4] << "\n";
+        out << "stats\n";
+        pcstats.write(out);
+        out.close();
+        if (!out) {
+            return 0;
+        }
+
+        // the rename is atomic, so a node going down mid-write leaves the previous checkpoint intact
+        return rename(tmpname.c_str(), checkpointname().c_str()) == 0;
+    }
+
+    bool SiteRP::readcheckpoint() {
+        std::ifstream in(checkpointname());
+        if (!in) {
+            std::cout << "There is no checkpoint " << checkpointname() << " to resume from, starting the sweep over.\n";
+            return 0;
+        }
+
+        std::string tag;
+        std::getline(in, tag);
+        int nn, ss, sz;
+        in >> tag >> nn >> ss >> sz;
+        float cc1, cc2, cdc;
+        int ntr;
+        in >> tag >> cc1 >> cc2 >> cdc >> ntr;
+
+        std::ostringstream mine;                    // compare the sweeps as written, so float rounding can't disagree
+        mine << std::setprecision(9) << sweep.c1 << " " << sweep.c2 << " " << sweep.dc;
+        std::ostringstream theirs;
+        theirs << std::setprecision(9) << cc1 << " " << cc2 << " " << cdc;
+        if (!in || nn != n || ss != s || sz != size || ntr != sweep.numtrials || mine.str() != theirs.str()) {
+            std::cout << "The checkpoint " << checkpointname() << " belongs to a different sweep, starting the sweep over.\n";
+            return 0;
+        }
+
+        unsigned int seed;
+        in >> tag >> seed;
+        size_t numjobs;
+        in >> tag >> numjobs;
+        if (!in || numjobs != sweep.jobdone.size()) {
+            return 0;
+        }
+        std::vector<char> done(numjobs, 0);
+        for (int job = 0; job < numjobs; job++) {
+            int d;
+            in >> d;
+            done[job] = d;
+        }
+
+        int job = -1;                               // version 1 checkpoints have no trial in flight
+        long long attempts = 0;
+        long long draws = 0;
+        in >> tag;
+        long long bytes[5] = {-1, -1, -1, -1, -1};
+        if (tag == "inflight") {
+            in >> job >> attempts >> draws;
+            in >> tag;
+        }
+        if (tag == "outputs") {                    // older checkpoints have no backbone file to record
+            std::string line;
+            std::getline(in, line);
+            std::istringstream lengths(line);
+            for (int k = 0; k < 5 && lengths >> bytes[k]; k++) {
+            }
+            in >> tag;
+        }
+
+        PcStats saved;
+        if (!in || tag != "stats" || !saved.read(in) || job >= int(numjobs)) {
+            std::cout << "The checkpoint " << checkpointname() << " is damaged, starting the sweep over.\n";
+            return 0;
+        }
+
+        // the snapshot of the trial in flight is saved just before the checkpoint, at the same number of draws,
+        // so one that is missing or at another number belongs to a different checkpoint. The statistics and the
+        // shared files already hold whatever that trial recorded, so it can't be redone from the start either
+        if (job >= 0) {
+            SnapshotView view;
+            if (!view.open(checkpointname() + ".snap") || view.header().rngdraws != draws) {
+                std::cout << "The checkpoint " << checkpointname() << " doesn't match the snapshot of the trial in flight, "
+                          << "starting the sweep over.\n";
+                return 0;
+            }
+        }
+
+        sweepseed = seed;
+        sweep.jobdone = done;
+        sweep.job = job;
+        sweep.numattempts = attempts;
+        for (int k = 0; k < 5; k++) {
+            sweep.outputbytes[k] = bytes[k];
+        }
+        pcstats = saved;
+        return 1;
+    }
+
+    std::string SiteRP::sequencename(float cval, int tval) {
+        char name[64];
+        snprintf(name, sizeof(name), "sequence_n%ds%d_c%03dt%04d.bin", n, s, int(cval * 100) % 1000, tval % 10000);
+        return name;
+    }
+
+    bool SiteRP::writesequence(const std::string &filename) {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "I couldn't open " << filename << " to record the trial.\n";
+            return 0;
+        }
+
+        SequenceHeader h = {};
+        memcpy(h.magic, SEQUENCE_MAGIC, sizeof(SEQUENCE_MAGIC));
+        h.version = SEQUENCE_VERSION;
+        h.byteorder = SNAPSHOT_BYTEORDER;
+        h.n = n;
+        h.s = s;
+        h.size = size;
+        h.trial = trialnum;
+        h.correlation = correlation;
+        h.width = size <= 65536 ? 2 : 4;
+        h.count = sequence.size();
+        out.write((const char *) &h, sizeof(h));
+
+        if (h.width == 2) {
+            std::vector<uint16_t> sites(sequence.begin(), sequence.end());
+            out.write((const char *) sites.data(), sites.size() * sizeof(uint16_t));
+        }
+        else {
+            std::vector<int32_t> sites(sequence.begin(), sequence.end());
+            out.write((const char *) sites.data(), sites.size() * sizeof(int32_t));
+        }
+        out.close();
+        return bool(out);
+    }
+
+    double SiteRP::replaytrial(const std::string &filename) {
+        std::ifstream in(filename, std::ios::binary);
+        SequenceHeader h;
+        if (!in || !in.read((char *) &h, sizeof(h)) || memcmp(h.magic, SEQUENCE_MAGIC, sizeof(SEQUENCE_MAGIC)) != 0 ||
+            h.byteorder != SNAPSHOT_BYTEORDER || h.version == 0 || h.version > SEQUENCE_VERSION) {
+            std::cout << "The file " << filename << " isn't a recorded trial this version can read.\n";
+            return -1;
+        }
+        if (h.n != n || h.s != s || h.size != size) {
+            std::cout << "The trial " << filename << " was recorded on an n=" << h.n << " s=" << h.s << " lattice, not this one.\n";
+            return -1;
+        }
+
+        std::vector<int> sites(h.count);
+        if (h.width == 2) {
+            std::vector<uint16_t> packed(h.count);
+            in.read((char *) packed.data(), packed.size() * sizeof(uint16_t));
+            sites.assign(packed.begin(), packed.end());
+        }
+        else {
+            std::vector<int32_t> packed(h.count);
+            in.read((char *) packed.data(), packed.size() * sizeof(int32_t));
+            sites.assign(packed.begin(), packed.end());
+        }
+        if (!in) {
+            std::cout << "The recorded trial " << filename << " is truncated.\n";
+            return -1;
+        }
+
+        initemptytrigraph();
+        correlation = h.correlation;
+        setfilestream(correlation, h.trial);
+        sequence.clear();
+        // the next site to place is always sites[numparts], so a replay taken back to its critical point by a check
+        // in the background carries on from there
+        do {
+            while (numparts < sites.size()) {
+                int site = sites[numparts];     // recorded by its layer by layer number
+                if (site < 0 || site >= size || occ[fromlegacy[site]] != 0) {
+                    std::cout << "The recorded trial " << filename << " places an impossible site " << site << ", stopping the replay.\n";
+                    sites.resize(numparts);
+                    break;
+                }
+                site = fromlegacy[site];
+                placesite(site);
+                checkspan(correlation);
+            }
+            placebatch();
+        } while (async_span && collectchecks(correlation, 0));
+        myfile.close();
+        rclusterfile.close();
+        return critical_pc;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SNAPSHOTS OF THE ENGINE STATE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// pads the snapshot out to the next multiple of 8 bytes so the following section can be used in place once mapped
+    static void snapshotalign(std::ofstream &out) {
+        static const char zeros[8] = {};
+        long pos = out.tellp();
+        if (pos % 8 != 0) {
+            out.write(zeros, 8 - pos % 8);
+        }
+    }
+
+// writes the per-site lists as size + 1 offsets followed by all the entries, and returns the number of entries.
+// Snapshots number the sites layer by layer, so list j is that of site fromlegacy[j], and site entries are renumbered.
+// The entries are 32 bits on disk whatever vertex_t is, as the engine holds at most 2^31 - 1 sites
+    template<typename T>
+    static uint64_t snapshotcsr(std::ofstream &out, const SiteLists<T> &lists, int numsites, const vertex_t *fromlegacy,
+                                const vertex_t *tolegacy, bool sitelists) {
+        uint64_t total = 0;
+        for (int j = 0; j <= numsites; j++) {
+            out.write((const char *) &total, sizeof(total));
+            if (j < numsites) {
+                total += lists[fromlegacy[j]].size();
+            }
+        }
+        for (int j = 0; j < numsites; j++) {
+            FixedList<T, uint8_t> list = lists[fromlegacy[j]];
+            for (int k = 0; k < list.size(); k++) {
+                int32_t entry = int32_t(sitelists ? tolegacy[list[k]] : list[k]);
+                out.write((const char *) &entry, sizeof(entry));
+            }
+        }
+        return total;
+    }
+
+// reads a CSR section of a mapped snapshot back into the per-site lists
+    template<typename T>
+    static void snapshotlists(const SnapshotView &view, SnapshotSection section, const SiteLists<T> &lists, int numsites,
+                              const vertex_t *fromlegacy, bool sitelists) {
+        for (int j = 0; j < numsites; j++) {
+            FixedList<T, uint8_t> list = lists[fromlegacy[j]];
+            list.clear();
+            if (view.has(section)) {
+                int length;
+                const int32_t *entries = view.list(section, j, length);
+                for (int k = 0; k < length; k++) {
+                    list.push_back(sitelists ? fromlegacy[entries[k]] : entries[k]);
+                }
+            }
+        }
+    }
+
+    bool SiteRP::savesnapshot(const std::string &filename) {
+        placebatch();                           // the snapshot has no room for bonds still to be added
+        loadlattice();
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "I couldn't open " << filename << " to write a snapshot.\n";
+            return 0;
+        }
+
+        SnapshotHeader h = {};
+        memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        h.version = SNAPSHOT_VERSION;
+        h.byteorder = SNAPSHOT_BYTEORDER;
+        h.headerbytes = sizeof(SnapshotHeader);
+        h.n = n;
+        h.s = s;
+        h.size = size;
+        h.ll = ll;
+        h.numparts = numparts;
+        h.numbonds = numbonds;
+        h.rbonds = rbonds;
+        h.giantsize_site = giantsize_site;
+        h.giantsize_bond = giantsize_bond;
+        h.giantindex = giantindex;
+        h.SpanLastStatus = SpanLastStatus;
+        h.flag_for_span_check = flag_for_span_check;
+        h.correlation = correlation;
+        h.sweepseed = sweepseed;
+        h.critical_pc = critical_pc;
+        h.rngdraws = rngdraws;
+        out.write((const char *) &h, sizeof(h));        // a placeholder until the section offsets are known
+
+        snapshotalign(out);
+        h.offset[SECTION_PC] = out.tellp();
+        h.count[SECTION_PC] = size;
+        for (int j = 0; j < size; j++) {
+            int16_t pebbles = pc[fromlegacy[j]];
+            out.write((const char *) &pebbles, sizeof(pebbles));
+        }
+
+        snapshotalign(out);
+        h.offset[SECTION_OCC] = out.tellp();
+        h.count[SECTION_OCC] = size;
+        for (int j = 0; j < size; j++) {
+            int16_t occupied = occ[fromlegacy[j]];
+            out.write((const char *) &occupied, sizeof(occupied));
+        }
+
+        snapshotalign(out);
+        h.offset[SECTION_EDGES] = out.tellp();
+        h.count[SECTION_EDGES] = edges.size();
+        for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+            SnapshotBond b = {int32_t(tolegacy[it->vertices.first]), int32_t(tolegacy[it->vertices.second]), it->RigidIndex};
+            out.write((const char *) &b, sizeof(b));
+        }
+
+        snapshotalign(out);
+        h.offset[SECTION_STRESSED] = out.tellp();
+        h.count[SECTION_STRESSED] = size;
+        for (int j = 0; j < size; j++) {
+            int16_t stress = stressed[fromlegacy[j]];
+            out.write((const char *) &stress, sizeof(stress));
+        }
+
+        snapshotalign(out);
+        h.offset[SECTION_STRESSEDEDGES] = out.tellp();
+        h.count[SECTION_STRESSEDEDGES] = edges.size();
+        for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+            uint8_t stress = it->stressed;
+            out.write((const char *) &stress, sizeof(stress));
+        }
+
+        const SiteLists<site_t> *lists[] = {&thegraph, &rgraph, &giantrigidcluster};
+        const SnapshotSection sections[] = {SECTION_GRAPH, SECTION_RGRAPH, SECTION_GIANT};
+        for (int k = 0; k < 3; k++) {
+            snapshotalign(out);
+            h.offset[sections[k]] = out.tellp();
+            h.count[sections[k]] = snapshotcsr(out, *lists[k], size, fromlegacy, tolegacy, true);
+        }
+        snapshotalign(out);
+        h.offset[SECTION_RCLUSTER] = out.tellp();
+        h.count[SECTION_RCLUSTER] = snapshotcsr(out, rcluster_site, size, fromlegacy, tolegacy, false);
+
+        out.seekp(0);
+        out.write((const char *) &h, sizeof(h));
+        out.close();
+        if (!out) {
+            std::cout << "Writing the snapshot " << filename << " failed.\n";
+            return 0;
+        }
+        return 1;
+    }
+
+    bool SiteRP::loadsnapshot(const std::string &filename) {
+        SnapshotView view;
+        if (!view.open(filename)) {
+            return 0;
+        }
+        const SnapshotHeader &h = view.header();
+        if (h.n != n || h.s != s || h.size != size) {
+            std::cout << "The snapshot " << filename << " is of an n=" << h.n << " s=" << h.s << " lattice, not this one.\n";
+            return 0;
+        }
+        // the lists and the bonds have to fit the room the engine keeps for them, as no site has more than 6 bonds
+        bool fits = view.numedges() <= 3 * uint64_t(size);
+        const SnapshotSection sections[] = {SECTION_GRAPH, SECTION_RGRAPH, SECTION_GIANT, SECTION_RCLUSTER};
+        for (int k = 0; k < 4 && fits; k++) {
+            for (int j = 0; j < size && fits && view.has(sections[k]); j++) {
+                int length;
+                view.list(sections[k], j, length);
+                fits = length <= 6;
+            }
+        }
+        if (!fits) {
+            std::cout << "The snapshot " << filename << " has more bonds at a site than the lattice has room for.\n";
+            return 0;
+        }
+
+        loadlattice();
+        stressedsites = 0;                      // version 1 snapshots don't know about stresses
+        stressedbonds = 0;
+        for (int j = 0; j < size; j++) {
+            int i = fromlegacy[j];
+            pc[i] = view.pc()[j];
+            occ[i] = view.occ()[j];
+            stressed[i] = view.has(SECTION_STRESSED) ? view.stressed()[j] : 0;
+            stressedsites += stressed[i] != 0;
+        }
+        occnearknown = false;
+        trialsitesknown = false;            // the sites were occupied without placesite
+        edges.clear();
+        bondsindexed = 0;
+        for (uint64_t k = 0; k < view.numedges(); k++) {
+            const SnapshotBond &b = view.edges()[k];
+            edges.push_back(Bond(fromlegacy[b.first], fromlegacy[b.second]));
+            edges.back().RigidIndex = b.RigidIndex;
+            edges.back().stressed = view.has(SECTION_STRESSEDEDGES) && view.stressededges()[k] != 0;
+            stressedbonds += edges.back().stressed;
+        }
+        snapshotlists(view, SECTION_GRAPH, thegraph, size, fromlegacy, true);
+        regionnum++;                        // the free pebble marks belonged to the old graph
+        snapshotlists(view, SECTION_RGRAPH, rgraph, size, fromlegacy, true);
+        snapshotlists(view, SECTION_GIANT, giantrigidcluster, size, fromlegacy, true);
+        snapshotlists(view, SECTION_RCLUSTER, rcluster_site, size, fromlegacy, false);
+
+        while (placesbeen.size() > 0) {
+            placesbeen.pop();
+        }
+        batch.clear();
+        numparts = h.numparts;
+        numbonds = h.numbonds;
+        rbonds = h.rbonds;
+        giantsize_site = h.giantsize_site;
+        giantsize_bond = h.giantsize_bond;
+        giantindex = h.giantindex;
+        SpanLastStatus = h.SpanLastStatus;
+        flag_for_span_check = h.flag_for_span_check;
+        correlation = h.correlation;
+        critical_pc = h.critical_pc;
+        rngdraws = h.rngdraws;
+        endjournal();
+        newepoch(SpanLastStatus);
+        if (span_test == SPAN_BUSBAR) {
+            buildopenlattice();
+        }
+        return 1;
+    }
+
+    std::string SiteRP::snapshotname(float cval, int tval) {
+        char name[64];
+        snprintf(name, sizeof(name), "snapshot_n%ds%d_c%03dt%04d.bin", n, s, int(cval * 100) % 1000, tval % 10000);
+        return name;
+    }
+
+// The bonds come in the engine's own numbering and so do the positions, so nothing needs translating. The sites of
+// column 0 are drawn a period to the right, in column ll, which is where the right edges of the gaskets they are on
+// lie, so that the picture is made of whole gaskets and only bonds between corners wrap
+    bool SiteRP::savepicture(const std::string &filename, int width) {
+        loadlattice();
+        std::vector<float> drawx(lattice->x(), lattice->x() + size);
+        int numlayers = 0;
+        for (int i = 0; i < size; i++) {
+            if (s != 1 && lattice->column()[i] == 0) {
+                drawx[i] += ll;
+            }
+            numlayers = std::max(numlayers, lattice->layer()[i] + 1);
+        }
+        RenderScene scene;
+        scene.size = size;
+        scene.x = drawx.data();
+        scene.y = lattice->y();
+        if (s != 1) {
+            scene.periods.push_back(std::make_pair(float(ll), 0.0f));
+            scene.periods.push_back(std::make_pair(float(0.5 * numlayers), float(-0.5 * sqrt(3.0) * numlayers)));
+        }
+        scene.occ = occ;
+        scene.giant.assign(size, 0);
+        for (int i = 0; i < size; i++) {
+            scene.giant[i] = !giantrigidcluster[i].empty();
+            for (int d = 1; d <= 6; d++) {
+                int j = choosedir_sg(i, d);
+                if (j > i) {
+                    scene.bonds.push_back(RenderBond{i, j, RENDER_LATTICE});
+                }
+            }
+            for (int k = 0; k < rgraph[i].size(); k++) {
+                scene.bonds.push_back(RenderBond{i, rgraph[i][k], RENDER_REDUNDANT});
+            }
+            for (int k = 0; k < giantrigidcluster[i].size(); k++) {
+                if (giantrigidcluster[i][k] > i) {
+                    scene.bonds.push_back(RenderBond{i, giantrigidcluster[i][k], RENDER_GIANT});
+                }
+            }
+        }
+        for (int b = 0; b < edges.size(); b++) {
+            scene.bonds.push_back(RenderBond{edges[b].vertices.first, edges[b].vertices.second, RENDER_INDEPENDENT});
+        }
+        return render(scene, filename, width);
+    }
+
+    std::string SiteRP::picturename(float cval, int tval) {
+        char name[64];
+        snprintf(name, sizeof(name), "picture_n%ds%d_c%03dt%04d.ppm", n, s, int(cval * 100) % 1000, tval % 10000);
+        return name;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SPANNING CHECKS IN THE BACKGROUND
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    std::shared_ptr<const StateSnapshot> SiteRP::publishstate() {
+        std::shared_ptr<StateSnapshot> snap = std::make_shared<StateSnapshot>();
+        snap->epoch = checkepoch;
+        snap->spanlast = epochstatus;
+        snap->giantsize_bond = giantsize_bond;      // only read at the first check of an epoch, when they are its starting ones
+        snap->giantsize_site = giantsize_site;
+        snap->numparts = numparts;
+        snap->numbonds = numbonds;
+        snap->rbonds = rbonds;
+        snap->stressedsites = stressedsites;
+        snap->stressedbonds = stressedbonds;
+
+        int numpages = (size + PAGE_SITES - 1) / PAGE_SITES;
+        snap->pages.resize(numpages);
+        for (int p = 0; p < numpages; p++) {
+            if (published && dirtypage[p] == 0) {
+                snap->pages[p] = published->pages[p];
+                continue;
+            }
+            std::shared_ptr<StatePage> page = std::make_shared<StatePage>();
+            for (int k = 0; k < PAGE_SITES && p * PAGE_SITES + k < size; k++) {
+                int i = p * PAGE_SITES + k;
+                page->pc[k] = pc[i];
+                page->occ[k] = occ[i];
+                page->stressed[k] = stressed[i];
+                page->graph[k].assign(thegraph[i].begin(), thegraph[i].end());
+            }
+            snap->pages[p] = page;
+            dirtypage[p] = 0;
+        }
+
+        int numbondpages = int((edges.size() + PAGE_BONDS - 1) / PAGE_BONDS);
+        dirtybonds.resize(numbondpages, 1);
+        snap->bondpages.resize(numbondpages);
+        for (int b = 0; b < numbondpages; b++) {
+            if (published && b < published->bondpages.size() && dirtybonds[b] == 0) {
+                snap->bondpages[b] = published->bondpages[b];
+                continue;
+            }
+            size_t last = std::min(edges.size(), size_t(b + 1) * PAGE_BONDS);
+            snap->bondpages[b] = std::make_shared<const std::vector<Bond> >(edges.begin() + size_t(b) * PAGE_BONDS, edges.begin() + last);
+            dirtybonds[b] = 0;
+        }
+        published = snap;
+        return snap;
+    }
+
+    void SiteRP::loadstate(const StateSnapshot &snap) {
+        for (int p = 0; p < snap.pages.size(); p++) {
+            const StatePage &page = *snap.pages[p];
+            for (int k = 0; k < PAGE_SITES && p * PAGE_SITES + k < size; k++) {
+                int i = p * PAGE_SITES + k;
+                pc[i] = page.pc[k];
+                occ[i] = page.occ[k];
+                stressed[i] = page.stressed[k];
+                thegraph[i].assign(page.graph[k].begin(), page.graph[k].end());
+            }
+        }
+        edges.clear();
+        bondsindexed = 0;
+        for (int b = 0; b < snap.bondpages.size(); b++) {
+            edges.insert(edges.end(), snap.bondpages[b]->begin(), snap.bondpages[b]->end());
+        }
+        occnearknown = false;
+        trialsitesknown = false;
+        numparts = snap.numparts;
+        numbonds = snap.numbonds;
+        rbonds = snap.rbonds;
+        stressedsites = snap.stressedsites;
+        stressedbonds = snap.stressedbonds;
+
+        while (placesbeen.size() > 0) {
+            placesbeen.pop();
+        }
+        regionnum++;                        // the free pebble marks belonged to the graph before
+        if (span_test == SPAN_BUSBAR) {
+            buildopenlattice();
+        }
+    }
+
+    void SiteRP::newepoch(int spanlast) {
+        checkepoch++;
+        epochstatus = spanlast;
+        pendingchecks.clear();
+        heldlines.clear();
+        published.reset();
+    }
+
+// The journal from the oldest check in flight on is what a rollback to its snapshot needs, so it is kept until
+// the last check is in. The snapshot itself is only ever read by the analyst
+    void SiteRP::submitcheck(float c) {
+        if (!analyst.running()) {
+            analyst.start(*this);
+        }
+        PendingCheck check;
+        check.journalmark = mark();
+        check.occsitesbytes = outputlength("mathematica_occsites_from_pebble.txt");
+        check.heldlines = int(heldlines.size());
+        pendingchecks.push_back(check);
+        analyst.submit(publishstate());
+        collectchecks(c, async_backlog);
+    }
+
+    bool SiteRP::collectchecks(float c, int leave) {
+        bool rolledback = false;
+        SpanResult r;
+        while (analyst.pending() > leave ? analyst.wait(r) : analyst.poll(r)) {
+            if (r.epoch != checkepoch) {
+                continue;                       // a check from before the trial restarted or was rolled back
+            }
+            PendingCheck check = pendingchecks.front();
+            pendingchecks.pop_front();
+
+            if (SpanLastStatus == 0 && r.span == 1) {
+                // the earliest snapshot that spans, the engine goes back to it and the critical point is found
+                // there, exactly as the check in line would have found it
+                rollback(check.journalmark);
+                endjournal();
+                newepoch(1);
+                cutoutput("mathematica_occsites_from_pebble.txt", check.occsitesbytes);
+                if (sequence.size() > numparts) {
+                    sequence.resize(numparts);
+                }
+                int span = findspan();
+                log(span);
+                if (span == 1) {
+                    recordcritical(c);
+                }
+                SpanLastStatus = span;
+                epochstatus = span;
+                rolledback = true;
+                continue;
+            }
+
+            giantsize_bond = r.giantsize_bond;
+            giantsize_site = r.giantsize_site;
+            logline(r.numparts, r.numbonds, r.rbonds, r.span);
+            SpanLastStatus = r.span;
+            int upto = pendingchecks.empty() ? int(heldlines.size()) : pendingchecks.front().heldlines;
+            for (int k = 0; k < upto; k++) {
+                logline(heldlines[k].numparts, heldlines[k].numbonds, heldlines[k].rbonds, -1);
+            }
+            heldlines.erase(heldlines.begin(), heldlines.begin() + upto);
+            for (int k = 0; k < pendingchecks.size(); k++) {
+                pendingchecks[k].heldlines -= upto;
+            }
+
+            if (pendingchecks.empty()) {
+                endjournal();
+            }
+            else if (pendingchecks.front().journalmark > journal.size() / 2) {   // drop what no rollback can reach now
+                int front = pendingchecks.front().journalmark;
+                journal.erase(journal.begin(), journal.begin() + front);
+                for (int k = 0; k < pendingchecks.size(); k++) {
+                    pendingchecks[k].journalmark -= front;
+                }
+            }
+        }
+        return rolledback;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// rigid cluster
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    bool SiteRP::isredundant(int i, int j)  //see if the test bond between (i,j) is redundant(dependent)
+    {
+        //if (numbonds < 2 * size - 3 &&
+        //    loadsites(i, j))            // if there are at least four pebbles left, we try to load the sites
+        if (numbonds < 2 * size - 3 &&
+            loadsites(i, j) && i!=j)            // if there are at least four pebbles left, we try to load the sites
+        {
+            return 0;                // if we succeed, then the edge from i to j is independent
+        }
+        else {
+            return 1;            // otherwise, the edge is redundant(dependent)
+        }
+    }
+
+    bool SiteRP::isbondrigid(Bond &a, Bond &b) //see if the two bonds a and b are rigid to each other
+    {
+        if (isredundant(a.vertices.first, b.vertices.first) && isredundant(a.vertices.first, b.vertices.second) &&
+            isredundant(a.vertices.second, b.vertices.first) && isredundant(a.vertices.second, b.vertices.second)) {
+            return 1; // if all the four test bonds between a1,b1; a1,b2; a2,b1; a2,b2 are redundant
+        }
+        else {
+            return 0;
+        }
+    }
+
+    void SiteRP::rigidcluster() // mark the rigid clusters
+    {
+        initgiantrigidcluster(); //empty the vector array first
+
+        int rcnum = 0; //index of the rigid cluster
+        giantsize_bond = 1; //if there exists any bond, the smallest possible giant rigid cluster bond size is 1
+        giantindex = 0; //the index for the giant rigid cluster (in this function)
+
+        bool serial = rigid_threads <= 1;
+        if (!serial) {
+            rcnum = threadedclusters();
+            if (rcnum < 0) {                    // a seed held four pebbles, so the threads' labels can't be trusted
+                for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+                    it->initBondRigidIndex();
+                }
+                rcnum = 0;
+                serial = true;
+            }
+        }
+        if (serial)
+        for (Bond * refBond = edges.begin(); refBond != edges.end(); ++refBond) {
+            if (refBond->RigidIndex == 0) {
+                int rclustersize_bond = 1;//the bond size of this rigid cluster
+                rcnum++;
+                refBond->RigidIndex = rcnum;
+                int pin1 = refBond->vertices.first;
+                int pin2 = refBond->vertices.second;
+                loadsites(pin1, pin2); // three pebbles on the ref bond, which are kept there while the test bonds are checked
+                for (Bond * testBond = edges.begin(); testBond != edges.end(); ++testBond) {
+                    if (testBond->RigidIndex == 0) {
+                        //the test and ref bonds are not in some rigid clusters
+                        if (!findfreepebble(testBond->vertices.first, pin1, pin2) &&
+                            !findfreepebble(testBond->vertices.second, pin1, pin2)) { //if test bond is rigid with respect to refbond
+                            testBond->RigidIndex = rcnum;
+                            rclustersize_bond++;
+                        }
+                    }
+                }
+                if (rclustersize_bond >= giantsize_bond) { //update the size of the giant rigid cluster
+                    giantsize_bond = rclustersize_bond;
+                    giantindex = rcnum;
+                }
+            }
+        }
+
+        // pick out the giant rigid cluster and store it in the vector "giantrigidcluster" (!!! we need it to become a undirected adjacent list)
+        // and note which clusters every site is in for the cluster table
+
+        std::vector<std::pair<int, int> > membership;
+        membership.reserve(2 * edges.size());
+        for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+            int site_I = it->vertices.first;
+            int site_J = it->vertices.second; //the two sites of the rigid bond
+            if (it->RigidIndex == giantindex) {
+                giantrigidcluster[site_I].push_back(site_J);
+                giantrigidcluster[site_J].push_back(site_I);
+            }
+            membership.push_back(std::make_pair(site_I, it->RigidIndex));
+            membership.push_back(std::make_pair(site_J, it->RigidIndex));
+        }
+        fillclusters(membership, rcnum);
+
+        for (int i = 0; i <= size - 1; i++) {
+            if (!giantrigidcluster[i].empty()) {
+                giantsize_site++;
+            }
+        }
+    }
+
+
+// Each thread takes the next bond no cluster has reached yet, pins three pebbles on it in its own copy of the
+// pebble game and grows its cluster out over the bonds whose ends can't find a free pebble, like seamrcluster().
+// Two threads can set off from bonds of the same cluster before either has labelled the other's, so a bond is
+// claimed with a compare and swap, and a thread that finds a bond already claimed by another id unites the two.
+// Numbering the clusters by their first bond afterwards gives the numbers the serial loop would have.
+// That holds while every seed pins exactly three pebbles. addbond leaves the redundant bonds in thegraph too,
+// and with them a seed can now and then gather four, after which it holds both its ends fixed and grows over
+// the clusters on either side. The serial loop only ever meets such a bond once its neighbours are labelled,
+// but a thread may meet it first, so on finding one the threads give up and -1 is returned
+    int SiteRP::threadedclusters() {
+        int numedges = int(edges.size());
+        std::vector<std::vector<int> > incident(size);  // the bonds at each site
+        for (int b = 0; b < numedges; b++) {
+            incident[edges[b].vertices.first].push_back(b);
+            incident[edges[b].vertices.second].push_back(b);
+        }
+
+        std::shared_ptr<const StateSnapshot> snap = publishstate();
+        while (clusterworkers.size() < rigid_threads) {
+            clusterworkers.push_back(std::unique_ptr<SiteRP>(new SiteRP));
+            clusterworkers.back()->lattice_order = lattice_order;
+            clusterworkers.back()->initemptytrigraph();
+        }
+
+        std::unique_ptr<std::atomic<int>[]> claim(new std::atomic<int>[numedges]);
+        for (int b = 0; b < numedges; b++) {
+            claim[b].store(0);                  // ids are bond indices plus one, 0 is unclaimed
+        }
+        sameclusters.reset(numedges + 1);
+        std::atomic<int> nextseed(0);
+        std::atomic<bool> overpinned(false);
+
+        std::vector<std::thread> workers;
+        for (int w = 0; w < rigid_threads; w++) {
+            workers.push_back(std::thread([this, w, numedges, &snap, &incident, &claim, &nextseed, &overpinned] {
+                SiteRP &engine = *clusterworkers[w];
+                engine.loadstate(*snap);
+                std::vector<int> sitecluster(size, 0);
+                std::vector<int> grow;
+                for (int seed = nextseed++; seed < numedges && !overpinned; seed = nextseed++) {
+                    int id = seed + 1;
+                    int expected = 0;
+                    if (!claim[seed].compare_exchange_strong(expected, id)) {
+                        continue;
+                    }
+                    int pin1 = edges[seed].vertices.first;
+                    int pin2 = edges[seed].vertices.second;
+                    engine.loadsites(pin1, pin2);
+                    if (engine.pc[pin1] + engine.pc[pin2] != 3) {
+                        overpinned = true;
+                        break;
+                    }
+                    sitecluster[pin1] = sitecluster[pin2] = id;
+                    grow.assign(1, pin1);
+                    grow.push_back(pin2);
+                    while (!grow.empty()) {
+                        int i = grow.back();
+                        grow.pop_back();
+                        for (int m = 0; m < incident[i].size(); m++) {
+                            int b = incident[i][m];
+                            int j = edges[b].vertices.first == i ? edges[b].vertices.second : edges[b].vertices.first;
+                            if (sitecluster[j] != id && engine.findfreepebble(j, pin1, pin2)) {
+                                continue;
+                            }
+                            if (sitecluster[j] != id) {
+                                sitecluster[j] = id;
+                                grow.push_back(j);
+                            }
+                            expected = 0;
+                            if (!claim[b].compare_exchange_strong(expected, id) && expected != id) {
+                                sameclusters.unite(id, expected);
+                            }
+                        }
+                    }
+                }
+            }));
+        }
+        for (int w = 0; w < rigid_threads; w++) {
+            workers[w].join();
+        }
+        if (overpinned) {
+            return -1;
+        }
 
-                setfilestream(correlation, mtc);
+        std::vector<int> number(numedges + 1, 0);
+        std::vector<int> bondsin(1, 0);
+        int rcnum = 0;
+        for (int b = 0; b < numedges; b++) {
+            int root = sameclusters.find(claim[b].load());
+            if (number[root] == 0) {
+                number[root] = ++rcnum;
+                bondsin.push_back(0);
+            }
+            edges[b].RigidIndex = number[root];
+            bondsin[number[root]]++;
+        }
+        for (int k = 1; k <= rcnum; k++) {
+            if (bondsin[k] >= giantsize_bond) {
+                giantsize_bond = bondsin[k];
+                giantindex = k;
+            }
+        }
+        return rcnum;
+    }
 
-                while (numattempts < maxout && numparts < size) {
-                    numattempts++;
+// The membership pairs are bucketed by site, and each site's few clusters sorted to drop the repeats. Every rigid
+// cluster of v sites has exactly 2 * v - 3 independent bonds, so the bonds follow from the sites
+    void SiteRP::fillclusters(const std::vector<std::pair<int, int> > &membership, int numclusters) {
+        clusters.numclusters = numclusters;
+        clusters.sites.assign(numclusters + 1, 0);
+        clusters.bonds.assign(numclusters + 1, 0);
+        clusters.sitestart.assign(size + 1, 0);
+        for (int k = 0; k < membership.size(); k++) {
+            clusters.sitestart[membership[k].first + 1]++;
+        }
+        for (int i = 0; i < size; i++) {
+            clusters.sitestart[i + 1] += clusters.sitestart[i];
+        }
+        clusters.siteclusters.resize(membership.size());
+        std::vector<int> next(clusters.sitestart.begin(), clusters.sitestart.end() - 1);
+        for (int k = 0; k < membership.size(); k++) {
+            clusters.siteclusters[next[membership[k].first]++] = membership[k].second;
+        }
 
-                    addtricluster2_sg(randsite0(), correlation);
+        int kept = 0;
+        for (int i = 0; i < size; i++) {
+            int begin = clusters.sitestart[i];
+            int end = clusters.sitestart[i + 1];
+            clusters.sitestart[i] = kept;
+            std::sort(clusters.siteclusters.begin() + begin, clusters.siteclusters.begin() + end);
+            for (int k = begin; k < end; k++) {
+                if (k == begin || clusters.siteclusters[k] != clusters.siteclusters[k - 1]) {
+                    clusters.siteclusters[kept++] = clusters.siteclusters[k];
+                    clusters.sites[clusters.siteclusters[k]]++;
                 }
             }
         }
+        clusters.sitestart[size] = kept;
+        clusters.siteclusters.resize(kept);
+        for (int k = 1; k <= numclusters; k++) {
+            clusters.bonds[k] = 2 * clusters.sites[k] - 3;
+        }
     }
 
-    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-// rigid cluster
+    bool SiteRP::hierarchicalrcluster()
+    {
+        if (!hierarchy.isbuilt()) {
+            if (neighbortable == nullptr) {
+                loadlattice();
+            }
+            // the hierarchy is given the lattice layer by layer, whatever order the engine keeps it in, and its
+            // sites are mapped back to the engine's below
+            std::vector<int> neighbors(6 * size);
+            for (int j = 0; j < size; j++) {
+                for (int d = 0; d < 6; d++) {
+                    int k = neighbortable[6 * fromlegacy[j] + d];
+                    neighbors[6 * j + d] = k == -1 ? -1 : tolegacy[k];
+                }
+            }
+            if (!hierarchy.build(n, s, neighbors)) {
+                return 0;
+            }
+        }
 
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        std::vector<sitestate_t> legacyocc(size);
+        for (int j = 0; j < size; j++) {
+            legacyocc[j] = occ[fromlegacy[j]];
+        }
+        bool span = hierarchy.solve(legacyocc.data());
 
-    bool SiteRP::isredundant(int i, int j)  //see if the test bond between (i,j) is redundant(dependent)
-    {
-        //if (numbonds < 2 * size - 3 &&
-        //    loadsites(i, j))            // if there are at least four pebbles left, we try to load the sites
-        if (numbonds < 2 * size - 3 &&
-            loadsites(i, j) && i!=j)            // if there are at least four pebbles left, we try to load the sites
-        {
-            return 0;                // if we succeed, then the edge from i to j is independent
+        // the labels of the hierarchy skip the clusters that were merged away, so they are renumbered from 1 in the
+        // order the bonds turn up, the way rigidcluster numbers them
+        initgiantrigidcluster();
+        std::vector<std::pair<int, int> > membership;
+        std::vector<int> renumber;
+        std::vector<char> ingiant(size, 0);
+        int numclusters = 0;
+        giantindex = 0;
+        for (int b = 0; b < hierarchy.bondlabel.size(); b++) {
+            int label = hierarchy.bondlabel[b];
+            if (label == -1) {
+                continue;
+            }
+            if (label >= renumber.size()) {
+                renumber.resize(label + 1, 0);
+            }
+            if (renumber[label] == 0) {
+                renumber[label] = ++numclusters;
+            }
+            int site_I = fromlegacy[hierarchy.bondsite[2 * b]];
+            int site_J = fromlegacy[hierarchy.bondsite[2 * b + 1]];
+            if (label == hierarchy.giantlabel) {
+                ingiant[site_I] = 1;
+                ingiant[site_J] = 1;
+                giantindex = renumber[label];
+            }
+            membership.push_back(std::make_pair(site_I, renumber[label]));
+            membership.push_back(std::make_pair(site_J, renumber[label]));
         }
-        else {
-            return 1;            // otherwise, the edge is redundant(dependent)
+        fillclusters(membership, numclusters);
+
+        // the hierarchy labels every bond of the lattice, but giantrigidcluster holds the independent bonds of the
+        // giant cluster as rigidcluster leaves it, which are the ones in edges with both ends in it (a bond is in
+        // only one cluster, and it is the one holding both its ends)
+        for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+            int site_I = it->vertices.first;
+            int site_J = it->vertices.second;
+            if (ingiant[site_I] && ingiant[site_J]) {
+                giantrigidcluster[site_I].push_back(site_J);
+                giantrigidcluster[site_J].push_back(site_I);
+            }
         }
+        giantsize_site = hierarchy.giantsize_site;
+        giantsize_bond = hierarchy.giantsize_bond;
+        return span;
     }
 
-    bool SiteRP::isbondrigid(Bond &a, Bond &b) //see if the two bonds a and b are rigid to each other
-    {
-        if (isredundant(a.vertices.first, b.vertices.first) && isredundant(a.vertices.first, b.vertices.second) &&
-            isredundant(a.vertices.second, b.vertices.first) && isredundant(a.vertices.second, b.vertices.second)) {
-            return 1; // if all the four test bonds between a1,b1; a1,b2; a2,b1; a2,b2 are redundant
+    void SiteRP::findcolumns() {
+        if (neighbortable == nullptr) {
+            loadlattice();
         }
-        else {
-            return 0;
+        const int32_t *columns = lattice->column();
+        for (int i = 0; i < size; i++) {
+            column[i] = (columns[i] % ll + ll) % ll;
         }
+        columnsknown = true;
     }
 
-    void SiteRP::rigidcluster() // mark the rigid clusters
-    {
-        initgiantrigidcluster(); //empty the vector array first
+    bool SiteRP::crossesseam(int i, int j) {
+        int ci = column[i];
+        int cj = column[j];
+        return (ci == ll - 1 && cj == 0) || (ci == 0 && cj == ll - 1);
+    }
 
-        int rcnum = 0; //index of the rigid cluster
-        giantsize_bond = 1; //if there exists any bond, the smallest possible giant rigid cluster bond size is 1
-        giantindex = 0; //the index for the giant rigid cluster (in this function)
+// A cluster that wraps around the lattice goes through every column, so it holds a bond across the seam, and the
+// giant cluster spans only if seamrcluster finds a cluster that does. A rigid cluster is connected, so each one is
+// grown out from its seam bond over the bonds at its sites, with the same pinned test as rigidcluster(), and the
+// rest of the lattice is never looked at
+    bool SiteRP::seamrcluster() {
+        if (!columnsknown) {
+            findcolumns();
+        }
+        initgiantrigidcluster();
 
-        for (std::vector<Bond>::iterator refBond = edges.begin(); refBond != edges.end(); ++refBond) {
-            if (refBond->RigidIndex == 0) {
-                int rclustersize_bond = 1;//the bond size of this rigid cluster
-                rcnum++;
-                refBond->RigidIndex = rcnum;
-                for (std::vector<Bond>::iterator testBond = edges.begin(); testBond != edges.end(); ++testBond) {
-                    if (testBond->RigidIndex == 0) {
-                        //the test and ref bonds are not in some rigid clusters
-                        if (isbondrigid(*refBond, *testBond) == true) { //if test bond is rigid with respect to refbond
-                            testBond->RigidIndex = rcnum;
-                            rclustersize_bond++;
-                        }
+        // the bonds at each site, seambonds[seamstart[i]] to seambonds[seamstart[i + 1]], kept between checks
+        seamstart.assign(size + 1, 0);
+        seambonds.resize(2 * edges.size());
+        std::vector<int> seeds;
+        if (giantseed >= 0 && giantseed < edges.size() &&
+            crossesseam(edges[giantseed].vertices.first, edges[giantseed].vertices.second)) {
+            seeds.push_back(giantseed);
+        }
+        for (int b = 0; b < edges.size(); b++) {
+            seamstart[edges[b].vertices.first + 1]++;
+            seamstart[edges[b].vertices.second + 1]++;
+            if (crossesseam(edges[b].vertices.first, edges[b].vertices.second)) {
+                seeds.push_back(b);
+            }
+        }
+        for (int i = 0; i < size; i++) {
+            seamstart[i + 1] += seamstart[i];
+        }
+        for (int b = 0; b < edges.size(); b++) {   // seamstart[i] runs on to the end of site i's bonds
+            seambonds[seamstart[edges[b].vertices.first]++] = b;
+            seambonds[seamstart[edges[b].vertices.second]++] = b;
+        }
+        for (int i = size; i > 0; i--) {
+            seamstart[i] = seamstart[i - 1];
+        }
+        seamstart[0] = 0;
+
+        seamcluster.assign(size, 0);
+        std::vector<int> clustersites;
+        std::vector<int> grow;
+        int rcnum = 0;
+        giantindex = 0;
+        giantsize_bond = 0;
+        bool span = false;
+        for (int k = 0; k < seeds.size() && !span; k++) {
+            Bond &refBond = edges[seeds[k]];
+            if (refBond.RigidIndex != 0) {
+                continue;
+            }
+            for (int m = 0; m < clustersites.size(); m++) {
+                giantrigidcluster[clustersites[m]].clear();
+            }
+            clustersites.clear();
+
+            int rclustersize_bond = 1;
+            rcnum++;
+            refBond.RigidIndex = rcnum;
+            int pin1 = refBond.vertices.first;
+            int pin2 = refBond.vertices.second;
+            loadsites(pin1, pin2);
+            seamcluster[pin1] = seamcluster[pin2] = rcnum;
+            clustersites.push_back(pin1);
+            clustersites.push_back(pin2);
+            giantrigidcluster[pin1].push_back(pin2);
+            giantrigidcluster[pin2].push_back(pin1);
+            grow.assign(clustersites.begin(), clustersites.end());
+            while (!grow.empty()) {
+                int i = grow.back();
+                grow.pop_back();
+                for (int m = seamstart[i]; m < seamstart[i + 1]; m++) {
+                    Bond &testBond = edges[seambonds[m]];
+                    int j = testBond.vertices.first == i ? testBond.vertices.second : testBond.vertices.first;
+                    if (testBond.RigidIndex != 0 || (seamcluster[j] != rcnum && findfreepebble(j, pin1, pin2))) {
+                        continue;
+                    }
+                    testBond.RigidIndex = rcnum;
+                    rclustersize_bond++;
+                    giantrigidcluster[i].push_back(j);
+                    giantrigidcluster[j].push_back(i);
+                    if (seamcluster[j] != rcnum) {
+                        seamcluster[j] = rcnum;
+                        clustersites.push_back(j);
+                        grow.push_back(j);
                     }
                 }
-                if (rclustersize_bond >= giantsize_bond) { //update the size of the giant rigid cluster
-                    giantsize_bond = rclustersize_bond;
-                    giantindex = rcnum;
+            }
+
+            // it has to reach every column to wrap. The adjacency is put in the order of edges, as rigidcluster()
+            // leaves it, so that spanningrcluster() walks the cluster the same way
+            if (clustersites.size() >= ll) {
+                for (int m = 0; m < clustersites.size(); m++) {
+                    giantrigidcluster[clustersites[m]].clear();
+                }
+                for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+                    if (it->RigidIndex == rcnum) {
+                        giantrigidcluster[it->vertices.first].push_back(it->vertices.second);
+                        giantrigidcluster[it->vertices.second].push_back(it->vertices.first);
+                    }
                 }
+                span = spanningrcluster();
+            }
+            if (span || rclustersize_bond >= giantsize_bond) {
+                giantsize_bond = rclustersize_bond;
+                giantindex = rcnum;
+                giantseed = seeds[k];
             }
         }
 
-        // pick out the giant rigid cluster and store it in the vector "giantrigidcluster" (!!! we need it to become a undirected adjacent list)
-
-        for (std::vector<Bond>::iterator it = edges.begin(); it != edges.end(); ++it) {
-            if (it->RigidIndex == giantindex) {
-                int site_I = it->vertices.first;
-                int site_J = it->vertices.second; //the two sites of the rigid bond
-                giantrigidcluster[site_I].push_back(site_J);
-                giantrigidcluster[site_J].push_back(site_I);
+        // leave the largest cluster grown in giantrigidcluster
+        for (int m = 0; m < clustersites.size(); m++) {
+            giantrigidcluster[clustersites[m]].clear();
+        }
+        giantsize_site = 0;
+        for (Bond * it = edges.begin(); it != edges.end(); ++it) {
+            if (giantindex != 0 && it->RigidIndex == giantindex) {
+                giantrigidcluster[it->vertices.first].push_back(it->vertices.second);
+                giantrigidcluster[it->vertices.second].push_back(it->vertices.first);
             }
         }
-
         for (int i = 0; i <= size - 1; i++) {
             if (!giantrigidcluster[i].empty()) {
                 giantsize_site++;
             }
         }
+        return span;
+    }
+
+    void SiteRP::buildopenlattice() {
+        if (!columnsknown) {
+            findcolumns();
+        }
+        openlattice.clear();
+        for (int i = 0; i < size + 4; i++) {
+            openlattice.addvertex();
+        }
+        openlattice.addbond(size, size + 1);
+        openlattice.addbond(size + 2, size + 3);
+        for (int i = 0; i < size; i++) {
+            for (int k = 0; k < thegraph[i].size(); k++) {
+                if (!crossesseam(i, thegraph[i][k])) {
+                    openlattice.addbond(i, thegraph[i][k]);
+                }
+            }
+        }
     }
 
+// Each boundary site gets a bond to both ends of its bar, which makes it part of the bar unless it is already
+// rigid with it. The bars are rigid with each other when, with three pebbles pinned on one, neither end of the
+// other can be reached by a free pebble. openlattice journals the test, so the rollback puts back the bonds and
+// pebbles exactly as the bonds of the lattice left them
+    bool SiteRP::busbarspan() {
+        openlattice.startjournal();
+        for (int i = 0; i < size; i++) {
+            if (occ[i] == 0 || (column[i] != 0 && column[i] != ll - 1)) {
+                continue;
+            }
+            int bar = column[i] == 0 ? size : size + 2;
+            openlattice.addbond(i, bar);
+            openlattice.addbond(i, bar + 1);
+        }
+
+        bool span = openlattice.rigidwith(size, size + 1, size + 2) && openlattice.rigidwith(size, size + 1, size + 3);
+
+        openlattice.rollback();
+        return span;
+    }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -767,33 +2731,15 @@
             rcluster_site[i].clear();
         }
 
-        // store the rigid cluster info to rcluster_site
-        for (std::vector<Bond>::iterator it = edges.begin(); it != edges.end() ; ++it) {
-            int site_I = it->vertices.first;
-            int site_J = it->vertices.second; //the two sites of the rigid bond
-
-// the following block of text was commented out which is used in computing cluster statistic information in SiteRP.cpp. This was not needed for my research, but it may be important for future users.
-            // if rcluster_site has not stored the RigidIndex, store it
-            /*if (std::find(rcluster_site[site_I].begin(),rcluster_site[site_I].end(),it->RigidIndex) == rcluster_site[site_I].end()){
-                rcluster_site[site_I].push_back(it->RigidIndex);
-            }
-            if (std::find(rcluster_site[site_J].begin(),rcluster_site[site_J].end(),it->RigidIndex) == rcluster_site[site_J].end()){
-                rcluster_site[site_J].push_back(it->RigidIndex);
-            }*/
-            //push the rigid indices to the rcluster_site in order to store the info
+        // store the rigid cluster info to rcluster_site, straight from the cluster table of the decomposition
+        for (int i = 0; i <= size - 1; ++i) {
+            rcluster_site[i].assign(clusters.siteclusters.begin() + clusters.sitestart[i],
+                                    clusters.siteclusters.begin() + clusters.sitestart[i + 1]);
         }
 
-        // print out the rigid cluster decomposition info
-        for (int st = 0; st <= size - 1; ++st) {
-            if (rcluster_site[st].empty()){
-                rclusterfile << "0" << "\n";
-            }
-            else{
-                for (std::vector<int>::iterator it = rcluster_site[st].begin(); it != rcluster_site[st].end(); ++it) {
-                    rclusterfile << *it << "\t";
-                }
-                rclusterfile << "\n";
-            }
+        // print out the rigid cluster decomposition info, the sites and independent bonds of each cluster in turn
+        for (int k = 1; k <= clusters.numclusters; ++k) {
+            rclusterfile << clusters.sites[k] << "\t" << clusters.bonds[k] << "\n";
         }
     }
 
@@ -890,52 +2836,23 @@
 // same function as addtricluster2_sg except it does use the rigidcluster function nor does it check for the spanning cluster 
     void SiteRP::addtricluster2_withoutRIGID_sg(int site, float c)
     {
-        int total_neighbors;
-        int numneighbors;
-        
         if (occ[site] == 0) {
             int newsite;
             
-            //Type 2 vertex
-            if (choosedir_sg(site, 1) == -1 && choosedir_sg(site, 2) == -1)
-            {
-                total_neighbors = 4;
-                numneighbors = occ[choosedir_sg(site, 3)] + occ[choosedir_sg(site, 4)] + occ[choosedir_sg(site, 5)] + occ[choosedir_sg(site, 6)];
-            }
-            
-            //Type 4 vertex
-            else if (choosedir_sg(site, 3) == -1 && choosedir_sg(site, 4) == -1)
-            {
-                total_neighbors = 4;
-                numneighbors = occ[choosedir_sg(site, 1)] + occ[choosedir_sg(site, 2)] + occ[choosedir_sg(site, 5)] + occ[choosedir_sg(site, 6)];
-            }
-            
-            //Type 3 vertex
-            else if (choosedir_sg(site, 5) == -1 && choosedir_sg(site, 6) == -1)
-            {
-                total_neighbors = 4;
-                numneighbors = occ[choosedir_sg(site, 1)] + occ[choosedir_sg(site, 2)] + occ[choosedir_sg(site, 3)] + occ[choosedir_sg(site, 4)];
-            }
-            
-            //Type 1 vertex
-            else
-            {
-                total_neighbors = 6;
-                numneighbors = occ[choosedir_sg(site, 1)] + occ[choosedir_sg(site, 2)] + occ[choosedir_sg(site, 3)] + occ[choosedir_sg(site, 4)] + occ[choosedir_sg(site, 5)] + occ[choosedir_sg(site, 6)];
-            }
-            
-            if (randprob() < pow(1. - c, total_neighbors - numneighbors)) {
+            if (accepted(site, c)) {
                 occ[site] = 1;
+                markneighbors(site, true);
+                trialsites.push_back(site);
                 
                 std::ofstream occsites;
                 occsites.open("mathematica_occsites_from_pebble.txt", std::ios::app);
-                occsites << site + 1 << std::endl;
+                occsites << tolegacy[site] + 1 << std::endl;
                 
                 numparts++;
                 for (int k = 1; k <= 6; k++) {
                     newsite = choosedir_sg(site, k);
                     
-                    if (occ[newsite] == 1 && isempty(site, newsite) && newsite != -1) {
+                    if (newsite != -1 && occ[newsite] == 1 && isempty(site, newsite)) {
                         addbond(site, newsite);
                     }
                 }
@@ -982,23 +2899,25 @@
         std::ofstream connects;
         connects.open("mathematica_lines_from_pebble.txt", std::ios::app);
         
-        for(int i = 0; i < size; i++)
+        for(int j = 0; j < size; j++)       // in layer by layer numbering, whatever the order of the lattice
         {
+            int i = fromlegacy[j];
             for (int index = 0; index < thegraph[i].size(); index++)
             {
-              connects << i + 1 << " " << thegraph[i].at(index) + 1 << std::endl;
+              connects << j + 1 << " " << tolegacy[thegraph[i].at(index)] + 1 << std::endl;
             }
         }
         
         std::ofstream outfile;
         outfile.open("rclusterout.txt");
-        for(int i=0; i < size; i++)
+        for(int j=0; j < size; j++)
         {
+            int i = fromlegacy[j];
             if(occ[i] != 0)
             {
                 if (!giantrigidcluster[i].empty() == 1)
                 {
-                    outfile << i + 1 << std::endl;
+                    outfile << j + 1 << std::endl;
                 }
             }
         }
@@ -1006,9 +2925,540 @@
         connects.close();
     }
 
-    void SiteRP::MultiTrialTest() //Generate multiple-times trial for triangular lattice (site RP)
+    void SiteRP::MultiTrialTest(bool resume) //Generate multiple-times trial for triangular lattice (site RP)
+    {
+        multictrial(size*100000000L,0.0,0.1,.2,20,resume); //That's it!
+    }
+
+    void SiteRP::AdaptiveTrialTest() //Generate trials until pc is known to a target precision at each correlation value
+    {
+        adaptivectrial(size*100000000L,0.0,0.1,.05,10,200,0.002);
+    }
+
+    void SiteRP::HierarchyTest() //Compare the hierarchical solver with the pebble game along one trial
+    {
+        initemptytrigraph();
+        int checks = 0;
+        int agreed = 0;
+        int check_every = std::max(1, int(size / 64));
+
+        while (numparts < size) {
+            int site = randsite0();
+            if (occ[site] != 0) {
+                continue;
+            }
+            placesite(site);
+            if (numparts % check_every != 0) {
+                continue;
+            }
+
+            rigidcluster();
+            bool span = spanningrcluster();
+            int sites = giantsize_site;
+            std::vector<std::vector<site_t> > giant(size);
+            for (int i = 0; i < size; i++) {
+                giant[i].assign(giantrigidcluster[i].begin(), giantrigidcluster[i].end());
+            }
+            bool hspan = hierarchicalrcluster();
+            bool samebonds = true;
+            for (int i = 0; span && i < size; i++) {    // before it spans, clusters can tie for the giant one
+                std::sort(giant[i].begin(), giant[i].end());
+                std::sort(giantrigidcluster[i].begin(), giantrigidcluster[i].end());
+                samebonds = samebonds && std::equal(giant[i].begin(), giant[i].end(), giantrigidcluster[i].begin(),
+                                                    giantrigidcluster[i].end());
+            }
+
+            checks++;
+            if (sites == giantsize_site && span == hspan && samebonds) {
+                agreed++;
+            }
+            else {
+                std::cout << "At " << numparts << " sites the pebble game has a giant cluster of " << sites << " sites"
+                          << (span ? " that spans" : "") << ", the hierarchical solver one of " << giantsize_site << " sites"
+                          << (hspan ? " that spans" : "") << (samebonds ? "" : ", and their giant clusters hold different bonds")
+                          << std::endl;
+            }
+        }
+        std::cout << "The hierarchical solver agreed with the pebble game at " << agreed << " of " << checks << " densities." << std::endl;
+    }
+
+    void SiteRP::GiantOnlyTest() //Compare the giant only spanning check with the whole decomposition along one trial
+    {
+        initemptytrigraph();
+        int checks = 0;
+        int agreed = 0;
+        double fulltime = 0;
+        double seamtime = 0;
+        int check_every = std::max(1, int(size / 64));
+
+        while (numparts < size) {
+            int site = randsite0();
+            if (occ[site] != 0) {
+                continue;
+            }
+            placesite(site);
+            if (numparts % check_every != 0) {
+                continue;
+            }
+
+            clock_t start = clock();
+            rigidcluster();
+            bool span = spanningrcluster();
+            fulltime += double(clock() - start) / CLOCKS_PER_SEC;
+            start = clock();
+            bool seamspan = seamrcluster();
+            seamtime += double(clock() - start) / CLOCKS_PER_SEC;
+
+            // a cluster other than the giant may wrap first, so only a giant that spans unnoticed is a disagreement
+            checks++;
+            if (seamspan || !span) {
+                agreed++;
+            }
+            else {
+                std::cout << "At " << numparts << " sites the giant cluster spans but the giant only check missed it" << std::endl;
+            }
+        }
+        std::cout << "The giant only check agreed with the whole decomposition at " << agreed << " of " << checks
+                  << " densities, taking " << seamtime << " s against " << fulltime << " s." << std::endl;
+    }
+
+    void SiteRP::BusBarTest() //Compare the bus bar spanning test with the wrapping one along one trial
+    {
+        int test = span_test;
+        span_test = SPAN_BUSBAR;
+        initemptytrigraph();
+        int wrapat = 0;
+        int barat = 0;
+        bool restored = true;
+        double wraptime = 0;
+        double bartime = 0;
+        int check_every = std::max(1, int(size / 64));
+
+        while (numparts < size && (wrapat == 0 || barat == 0)) {
+            int site = randsite0();
+            if (occ[site] != 0) {
+                continue;
+            }
+            placesite(site);
+            if (numparts % check_every != 0) {
+                continue;
+            }
+
+            clock_t start = clock();
+            rigidcluster();
+            if (spanningrcluster() && wrapat == 0) {
+                wrapat = numparts;
+            }
+            wraptime += double(clock() - start) / CLOCKS_PER_SEC;
+            PebbleGame before = openlattice;
+            start = clock();
+            if (busbarspan() && barat == 0) {
+                barat = numparts;
+            }
+            bartime += double(clock() - start) / CLOCKS_PER_SEC;
+            if (!(openlattice == before)) {
+                restored = false;
+            }
+        }
+        std::cout << "The giant cluster first wraps at " << wrapat << " sites and the bus bars are first rigid with each other at "
+                  << barat << " sites, taking " << bartime << " s against " << wraptime << " s." << std::endl;
+        if (!restored) {
+            std::cout << "The bus bar test left the open lattice different from how it found it." << std::endl;
+        }
+        span_test = test;
+    }
+
+    void SiteRP::AsyncSpanTest() //Compare the critical points of trials checked in the background with checking them in line
+    {
+        bool async = async_span;
+        int trials = 4;
+        int agreed = 0;
+        double walltime[2] = {0, 0};
+
+        for (int trial = 1; trial <= trials; trial++) {
+            unsigned int seed = rand();
+            int counts[2][6];
+            for (int mode = 0; mode < 2; mode++) {
+                async_span = mode == 1;
+                srand(seed);
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                onectrial(size * 100000LL, correlation, trial, true);
+                walltime[mode] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                int found[6] = {numparts, numbonds, rbonds, stressedsites, stressedbonds, giantsize_site};
+                std::copy(found, found + 6, counts[mode]);
+            }
+            if (std::equal(counts[0], counts[0] + 6, counts[1])) {
+                agreed++;
+            }
+            else {
+                std::cout << "Trial " << trial << " reached its critical point at " << counts[1][0] << " sites in the background and at "
+                          << counts[0][0] << " in line" << std::endl;
+            }
+        }
+        std::cout << "Checking in the background found the same critical point in " << agreed << " of " << trials
+                  << " trials, taking " << walltime[1] << " s against " << walltime[0] << " s." << std::endl;
+        async_span = async;
+    }
+
+    void SiteRP::BlockGameTest() //Compare the pebble game played block by block with the serial one along one trial
+    {
+        int blocks = parallel_blocks;
+        parallel_blocks = 0;
+        initemptytrigraph();
+        int checks = 0;
+        int agreed = 0;
+        double walltime[2] = {0, 0};
+        int check_every = std::max(1, int(size / 16));
+
+        while (numparts < size) {
+            int site = randsite0();
+            if (occ[site] != 0) {
+                continue;
+            }
+            placesite(site);
+            if (numparts % check_every != 0) {
+                continue;
+            }
+
+            // the same occupied sites, played again from scratch one bond at a time and then by blocks
+            int found[2][2];
+            std::vector<std::pair<int, int> > sizes[2];
+            for (int mode = 0; mode < 2; mode++) {
+                parallel_blocks = mode == 0 ? 1 : s;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                rebuildbyblocks();
+                walltime[mode] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                rigidcluster();
+                found[mode][0] = numbonds;
+                found[mode][1] = rbonds;
+                for (int k = 1; k <= clusters.numclusters; k++) {
+                    sizes[mode].push_back(std::make_pair(clusters.sites[k], clusters.bonds[k]));
+                }
+                std::sort(sizes[mode].begin(), sizes[mode].end());
+            }
+            parallel_blocks = 0;
+
+            checks++;
+            if (found[0][0] == found[1][0] && found[0][1] == found[1][1] && sizes[0] == sizes[1]) {
+                agreed++;
+            }
+            else {
+                std::cout << "At " << numparts << " sites the blocks found " << found[1][0] << " independent bonds and "
+                          << sizes[1].size() << " rigid clusters, against " << found[0][0] << " and " << sizes[0].size() << std::endl;
+            }
+        }
+        std::cout << "Playing the pebble game by blocks agreed with playing it serially at " << agreed << " of " << checks
+                  << " densities, taking " << walltime[1] << " s against " << walltime[0] << " s." << std::endl;
+        parallel_blocks = blocks;
+    }
+
+    void SiteRP::ThreadedClusterTest() //Compare the rigid clusters grown on several threads with rigidcluster() along a random trial and the one of seed 11
+    {
+        int threads = rigid_threads;
+        rigid_threads = std::max(threads, 2);   // on while placing too, so the pages it changes get marked
+        int checks = 0;
+        int agreed = 0;
+        double walltime[2] = {0, 0};
+        int check_every = std::max(1, int(size / 16));
+        unsigned int seeds[2] = {unsigned(rand()), 11};    // at 624 sites, seed 11 pins a bond with four pebbles
+
+        for (int trial = 0; trial < 2; trial++) {
+            srand(seeds[trial]);
+            initemptytrigraph();
+            while (numparts < size) {
+                int site = randsite0();
+                if (occ[site] != 0) {
+                    continue;
+                }
+                placesite(site);
+                if (numparts % check_every != 0) {
+                    continue;
+                }
+
+                // the same independent bonds decomposed on one thread and on several, label for label
+                std::vector<int> labels[2];
+                int giant[2][2];
+                for (int mode = 0; mode < 2; mode++) {
+                    rigid_threads = mode == 0 ? 0 : std::max(threads, 2);
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    rigidcluster();
+                    walltime[mode] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    for (int b = 0; b < edges.size(); b++) {
+                        labels[mode].push_back(edges[b].RigidIndex);
+                    }
+                    giant[mode][0] = giantindex;
+                    giant[mode][1] = giantsize_site;
+                }
+
+                checks++;
+                if (labels[0] == labels[1] && giant[0][0] == giant[1][0] && giant[0][1] == giant[1][1]) {
+                    agreed++;
+                }
+                else {
+                    std::cout << "At " << numparts << " sites the threads found giant cluster " << giant[1][0] << " of "
+                              << giant[1][1] << " sites, against " << giant[0][0] << " of " << giant[0][1] << std::endl;
+                }
+            }
+        }
+        std::cout << "Growing the rigid clusters on threads agreed with rigidcluster() at " << agreed << " of " << checks
+                  << " densities, taking " << walltime[1] << " s against " << walltime[0] << " s." << std::endl;
+        rigid_threads = threads;
+    }
+
+    void SiteRP::LatticeCacheTest() //Compare the mapped lattice table with working every neighbor out with DoEverything
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        loadlattice();
+        double tabletime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int checks = 0;
+        int agreed = 0;
+        start = std::chrono::steady_clock::now();
+        for (int site = 0; site < size; site++) {     // DoEverything numbers the sites layer by layer
+            for (int d = 1; d <= 6; d++) {
+                int nb = s == 1 ? DoEverything_osg(site, n, size, d) : DoEverything(site, n, s, size, d);
+                int tb = choosedir_sg(fromlegacy[site], d);
+                // the mask has to say whether the neighbor is there, and the neighbor has to see the site back in the
+                // opposite direction for markneighbors
+                bool masked = ((neighbormask[fromlegacy[site]] >> (d - 1)) & 1) == (tb != -1) &&
+                              (tb == -1 || choosedir_sg(tb, (d + 2) % 6 + 1) == fromlegacy[site]);
+                tb = tb < 0 ? tb : tolegacy[tb];
+                checks++;
+                if (nb == tb && masked) {
+                    agreed++;
+                }
+                else {
+                    std::cout << "The table gives " << tb << " as the neighbor of " << site
+                              << " in direction " << d << ", against " << nb << std::endl;
+                }
+            }
+        }
+        double directtime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // built again on one thread and on one per strip, which should give the same table byte for byte
+        LatticeView built[2];
+        double buildtime[2];
+        for (int mode = 0; mode < 2; mode++) {
+            start = std::chrono::steady_clock::now();
+            built[mode].build(n, s, size, mode == 0 ? 1 : s, lattice_order);
+            buildtime[mode] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        bool same = true;
+        for (int i = 0; i < size; i++) {
+            for (int d = 1; d <= 6; d++) {
+                same = same && built[0].neighbor(i, d) == built[1].neighbor(i, d) && built[0].neighbor(i, d) == choosedir_sg(i, d);
+            }
+            same = same && built[0].type()[i] == built[1].type()[i] && built[0].layer()[i] == built[1].layer()[i] &&
+                   built[0].column()[i] == built[1].column()[i] && built[0].x()[i] == built[1].x()[i] &&
+                   built[0].y()[i] == built[1].y()[i] && built[0].legacy()[i] == built[1].legacy()[i] &&
+                   built[0].mask()[i] == built[1].mask()[i] && built[0].degree()[i] == built[1].degree()[i];
+        }
+        std::cout << "Building the table on " << s << " threads " << (same ? "gave" : "did not give")
+                  << " the table built on one, taking " << buildtime[1] << " s against " << buildtime[0] << " s." << std::endl;
+        std::cout << "The lattice table (" << (lattice->ismapped() ? "mapped from " + latticename(n, s, lattice_order) : "built in memory")
+                  << ") agreed with DoEverything for " << agreed << " of " << checks << " neighbors, taking " << tabletime
+                  << " s to load against " << directtime << " s to work them out." << std::endl;
+    }
+
+    void SiteRP::RenderTest() //Draw a trial at its critical point as a PPM image and as SVG
+    {
+        initemptytrigraph();
+        int check_every = std::max(1, int(size / 64));
+        bool span = false;
+        while (numparts < size && !span) {
+            int site = randsite0();
+            if (occ[site] != 0) {
+                continue;
+            }
+            placesite(site);
+            if (numparts % check_every == 0 || numparts == size) {
+                rigidcluster();
+                span = spanningrcluster();
+            }
+        }
+        rigidcluster();
+
+        std::string names[2] = {"render_n" + std::to_string(n) + "s" + std::to_string(s) + ".ppm",
+                                "render_n" + std::to_string(n) + "s" + std::to_string(s) + ".svg"};
+        for (int k = 0; k < 2; k++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bool drawn = savepicture(names[k]);
+            double drawtime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << (drawn ? "Drew " : "Couldn't draw ") << numparts << " sites and a giant cluster of "
+                      << giantsize_site << " to " << names[k] << " in " << drawtime << " s." << std::endl;
+        }
+    }
+
+    void SiteRP::LatticeOrderTest() //Compare a trial played on the lattice in Morton order with the same trial layer by layer
+    {
+        SiteRP morton;
+        morton.lattice_order = ORDER_MORTON;
+        lattice_order = ORDER_LAYERS;
+        initemptytrigraph();
+        morton.initemptytrigraph();
+        int checks = 0;
+        int agreed = 0;
+        double time[2] = {0, 0};
+        int check_every = std::max(1, int(size / 64));
+
+        while (numparts < size) {
+            int j = rand() % size;              // the same layer by layer site goes into both engines
+            int site = fromlegacy[j];
+            if (occ[site] != 0) {
+                continue;
+            }
+            clock_t start = clock();
+            placesite(site);
+            time[0] += double(clock() - start) / CLOCKS_PER_SEC;
+            start = clock();
+            morton.placesite(morton.fromlegacy[j]);
+            time[1] += double(clock() - start) / CLOCKS_PER_SEC;
+            if (numparts % check_every != 0) {
+                continue;
+            }
+
+            start = clock();
+            rigidcluster();
+            bool span = spanningrcluster();
+            time[0] += double(clock() - start) / CLOCKS_PER_SEC;
+            start = clock();
+            morton.rigidcluster();
+            bool mortonspan = morton.spanningrcluster();
+            time[1] += double(clock() - start) / CLOCKS_PER_SEC;
+
+            bool same = span == mortonspan && numbonds == morton.numbonds && rbonds == morton.rbonds &&
+                        giantsize_site == morton.giantsize_site;
+            for (int k = 0; k < size; k++) {
+                same = same && pc[fromlegacy[k]] == morton.pc[morton.fromlegacy[k]] &&
+                       giantrigidcluster[fromlegacy[k]].size() == morton.giantrigidcluster[morton.fromlegacy[k]].size();
+            }
+            checks++;
+            if (same) {
+                agreed++;
+            }
+            else {
+                std::cout << "At " << numparts << " sites the Morton ordered lattice gave a giant cluster of "
+                          << morton.giantsize_site << " sites, against " << giantsize_site << std::endl;
+            }
+        }
+        std::cout << "The trial in Morton order agreed with the one layer by layer at " << agreed << " of " << checks
+                  << " densities, taking " << time[1] << " s against " << time[0] << " s." << std::endl;
+    }
+
+    void SiteRP::ResetTest() //Play short trials back to back and check that each reset of only the sites used leaves the engine empty
+    {
+        SiteRP swept;                           // the same trials, clearing every site at each reset
+        int trials = 32;
+        int emptied = 0;
+        int agreed = 0;
+        double time[2] = {0, 0};
+
+        for (int t = 0; t < trials; t++) {
+            clock_t start = clock();
+            initemptytrigraph();
+            time[0] += double(clock() - start) / CLOCKS_PER_SEC;
+            start = clock();
+            swept.trialsitesknown = false;
+            swept.initemptytrigraph();
+            time[1] += double(clock() - start) / CLOCKS_PER_SEC;
+
+            bool empty = numparts == 0 && numbonds == 0 && rbonds == 0 && edges.empty();
+            for (int i = 0; i < size && empty; i++) {
+                empty = pc[i] == 2 && occ[i] == 0 && stressed[i] == 0 && occnear[i] == 0 && thegraph[i].empty() &&
+                        rgraph[i].empty() && giantrigidcluster[i].empty();
+            }
+            if (empty) {
+                emptied++;
+            }
+            else {
+                std::cout << "Trial " << t << " started with something left over from the one before" << std::endl;
+            }
+
+            int length = 1 + rand() % (size / 8);   // short trials, where the reset used to be most of the work
+            while (numparts < length) {
+                int site = randsite0();
+                if (occ[site] != 0) {
+                    continue;
+                }
+                placesite(site);
+                swept.placesite(site);
+            }
+            rigidcluster();
+            bool span = spanningrcluster();
+            swept.rigidcluster();
+            bool sweptspan = swept.spanningrcluster();
+
+            bool same = span == sweptspan && numbonds == swept.numbonds && rbonds == swept.rbonds &&
+                        giantsize_site == swept.giantsize_site;
+            for (int i = 0; i < size && same; i++) {
+                same = pc[i] == swept.pc[i] && thegraph[i] == swept.thegraph[i];
+            }
+            if (same) {
+                agreed++;
+            }
+            else {
+                std::cout << "Trial " << t << " of " << length << " sites came out differently after the short reset" << std::endl;
+            }
+        }
+        std::cout << "Resetting only the sites used left the engine empty for " << emptied << " of " << trials
+                  << " trials, which agreed with clearing every site for " << agreed << ", the resets taking " << time[0]
+                  << " s against " << time[1] << " s." << std::endl;
+    }
+
+    void SiteRP::JournalTest() //Place sites speculatively along one trial and check that rolling them back restores the engine
     {
-        multictrial(size*100000000L,0.0,0.1,.2,20); //That's it!
+        initemptytrigraph();
+        int checks = 0;
+        int restored = 0;
+        int check_every = std::max(1, int(size / 64));
+
+        while (numparts < size) {
+            int site = randsite0();
+            if (occ[site] != 0) {
+                continue;
+            }
+            placesite(site);
+            if (numparts % check_every != 0) {
+                continue;
+            }
+
+            std::vector<sitestate_t> pcbefore(pc, pc + size);
+            std::vector<sitestate_t> occbefore(occ, occ + size);
+            std::vector<site_t> graphbefore[size];
+            for (int i = 0; i < size; i++) {
+                graphbefore[i].assign(thegraph[i].begin(), thegraph[i].end());
+            }
+            int bondsbefore = numbonds;
+            int rbondsbefore = rbonds;
+            int edgesbefore = int(edges.size());
+            int stressedbefore = stressedsites;
+
+            int m = mark();
+            for (int k = 0; k < 8 && numparts < size; k++) {
+                int what = randsite0();
+                if (occ[what] == 0) {
+                    placesite(what);
+                }
+                wouldberedundant(randsite0(), randsite0());
+            }
+            rollback(m);
+            endjournal();
+
+            checks++;
+            bool same = bondsbefore == numbonds && rbondsbefore == rbonds && edgesbefore == edges.size() &&
+                        stressedbefore == stressedsites;
+            for (int i = 0; i < size && same; i++) {
+                same = pcbefore[i] == pc[i] && occbefore[i] == occ[i] && std::equal(graphbefore[i].begin(), graphbefore[i].end(),
+                                                                                     thegraph[i].begin(), thegraph[i].end());
+            }
+            if (same) {
+                restored++;
+            }
+            else {
+                std::cout << "At " << numparts << " sites rolling back didn't restore the engine" << std::endl;
+            }
+        }
+        std::cout << "Rolling back restored the engine at " << restored << " of " << checks << " densities." << std::endl;
     }
 
     void SiteRP::PlotNetworkTest() //Generate network plot file
@@ -1023,14 +3473,17 @@
         rigidcluster();
 
         int span = spanningrcluster();
+
+        lattice->writelines("mathematica_lines.txt");
         
         std::ofstream connects;
         connects.open("mathematica_lines_from_pebble.txt", std::ios::app);
-        for(int i = 0; i < size; i++)
+        for(int j = 0; j < size; j++)       // in layer by layer numbering, whatever the order of the lattice
         {
+            int i = fromlegacy[j];
             for (int index = 0; index < thegraph[i].size(); index++)
             {
-                connects << i + 1 << " " << thegraph[i].at(index) + 1 << std::endl;
+                connects << j + 1 << " " << tolegacy[thegraph[i].at(index)] + 1 << std::endl;
             }
         }
         connects.close();
@@ -1040,12 +3493,13 @@
         
         std::ofstream outfile;
         outfile.open("rclusterout.txt");
-        for(int i=0; i < size; i++)
+        for(int j=0; j < size; j++)
         {
+            int i = fromlegacy[j];
             if(occ[i] != 0){
                 if (!giantrigidcluster[i].empty() == 1)
                 {
-                    outfile << i + 1 << std::endl;
+                    outfile << j + 1 << std::endl;
                 }
             }
         }
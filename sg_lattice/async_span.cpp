@@ -0,0 +1,125 @@
+//
+// A background thread that runs the spanning checks of a SiteRP on snapshots of its state
+//
+
+#include "async_span.h"
+#include "siteRP.h"
+
+AsyncSpan::~AsyncSpan()
+{
+    stop();
+}
+
+void AsyncSpan::start(const SiteRP &settings)
+{
+    stop();
+    engine = new SiteRP;
+    engine->use_hierarchy = settings.use_hierarchy;
+    engine->giant_only = settings.giant_only;
+    engine->span_test = settings.span_test;
+    engine->lattice_order = settings.lattice_order;
+    engine->initemptytrigraph();
+    worker = std::thread(&AsyncSpan::run, this);
+}
+
+void AsyncSpan::stop()
+{
+    if (engine == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+    delete engine;
+    engine = nullptr;
+    queue.clear();
+    results.clear();
+    inflight = 0;
+    stopping = false;
+}
+
+void AsyncSpan::submit(std::shared_ptr<const StateSnapshot> snap)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(snap);
+        inflight++;
+    }
+    wake.notify_one();
+}
+
+int AsyncSpan::pending()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return inflight;
+}
+
+bool AsyncSpan::poll(SpanResult &r)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (results.empty()) {
+        return false;
+    }
+    r = results.front();
+    results.pop_front();
+    inflight--;
+    return true;
+}
+
+bool AsyncSpan::wait(SpanResult &r)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (inflight == 0) {
+        return false;
+    }
+    finished.wait(guard, [this] { return !results.empty(); });
+    r = results.front();
+    results.pop_front();
+    inflight--;
+    return true;
+}
+
+// The worker's engine carries its spanning status and giant cluster sizes from one check to the next like the
+// main engine does, except at the start of an epoch, when it takes the ones the new run of checks follows on from
+void AsyncSpan::run()
+{
+    long long epoch = -1;
+    while (true) {
+        std::shared_ptr<const StateSnapshot> snap;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            snap = queue.front();
+            queue.pop_front();
+        }
+
+        if (snap->epoch != epoch) {
+            epoch = snap->epoch;
+            engine->SpanLastStatus = snap->spanlast;
+            engine->giantsize_bond = snap->giantsize_bond;
+            engine->giantsize_site = snap->giantsize_site;
+        }
+        engine->loadstate(*snap);
+        SpanResult r;
+        r.epoch = snap->epoch;
+        r.span = engine->findspan();
+        r.numparts = engine->numparts;
+        r.numbonds = engine->numbonds;
+        r.rbonds = engine->rbonds;
+        r.giantsize_bond = engine->giantsize_bond;
+        r.giantsize_site = engine->giantsize_site;
+        engine->SpanLastStatus = r.span;
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            results.push_back(r);
+        }
+        finished.notify_one();
+    }
+}
@@ -0,0 +1,56 @@
+//
+// A background thread that runs the spanning checks of a SiteRP on snapshots of its state
+//
+
+#ifndef PEBBLEGAMETEST_ASYNC_SPAN_H
+#define PEBBLEGAMETEST_ASYNC_SPAN_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "state_pages.h"
+
+class SiteRP;
+
+// what the analyst found in one snapshot, the numbers checkspan would have logged for it
+struct SpanResult {
+    long long epoch = 0;
+    int numparts = 0;
+    int numbonds = 0;
+    int rbonds = 0;
+    int giantsize_bond = 0;
+    int giantsize_site = 0;
+    int span = 0;
+};
+
+// AsyncSpan owns a worker thread with an engine of its own, set up with the same spanning test as the SiteRP that
+// started it. Snapshots are analysed in the order they were submitted and their results come back in that order,
+// so the first spanning result is always that of the earliest spanning snapshot
+class AsyncSpan {
+public:
+    ~AsyncSpan();
+    void start(const SiteRP &settings);     // starts the worker, copying the spanning test settings of the engine
+    void stop();                            // drops the snapshots still queued and waits for the worker to finish
+    bool running() const { return engine != nullptr; }
+    void submit(std::shared_ptr<const StateSnapshot> snap);
+    int pending();                          // snapshots submitted whose result hasn't been taken yet
+    bool poll(SpanResult &r);               // takes the next result if it is ready
+    bool wait(SpanResult &r);               // waits for the next result, false if nothing is in flight
+
+private:
+    void run();
+
+    SiteRP *engine = nullptr;               // only touched by the worker once it has started
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;           // there is a snapshot to analyse, or the worker should stop
+    std::condition_variable finished;       // there is a result to take
+    std::deque<std::shared_ptr<const StateSnapshot> > queue;
+    std::deque<SpanResult> results;
+    int inflight = 0;
+    bool stopping = false;
+};
+
+#endif //PEBBLEGAMETEST_ASYNC_SPAN_H
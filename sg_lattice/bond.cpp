@@ -9,8 +9,9 @@ void Bond::initBondRigidIndex ()
     RigidIndex = 0;
 }
 
-Bond::Bond (int x_input, int y_input)
+Bond::Bond (vertex_t x_input, vertex_t y_input)
 {
     vertices = std::make_pair(x_input,y_input);
     RigidIndex = 0;
+    stressed = false;
 }
\ No newline at end of file
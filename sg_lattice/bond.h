@@ -6,14 +6,16 @@
 #define PEBBLEGAMETEST_BOND_H
 
 #include <iostream>
+#include "vertex_index.h"
 
 class Bond{
 public:
-    std::pair<int, int> vertices; // the connected vertices
+    std::pair<vertex_t, vertex_t> vertices; // the connected vertices
     int RigidIndex;         //  the rigid cluster index
-    Bond (int x_input, int y_input);
+    bool stressed;          //  whether the bond is in an overconstrained (stressed) region
+    Bond (vertex_t x_input, vertex_t y_input);
     void initBondRigidIndex ();
-    std::pair<int,int> vertex() const { return vertices;}; // to get the vertices of the class Bond
+    std::pair<vertex_t,vertex_t> vertex() const { return vertices;}; // to get the vertices of the class Bond
 };
 
 #endif //PEBBLEGAMETEST_BOND_H
@@ -18,24 +18,32 @@
 using namespace std;
 
 //Calculates the total number of vertices in the system
-int TotalVerts(int n, int s)
+//in integers, so nothing is lost to pow, and in 64 bits, so a lattice too big for vertex_t is caught (-1)
+vertex_t TotalVerts(int n, int s)
 {
-    int var = 0;
+    int64_t var = 0;
+    int64_t power = 1;
     
     for(int k = 0; k <= n; k++)
     {
-        var += pow(3,k);
+        var += power;
+        power *= 3;
     }
     
-    int size = pow(s,2) * var;
-    return size;
+    int64_t size = int64_t(s) * s * var;
+    if(size > VERTEX_MAX)
+    {
+        cout << "A lattice of n = " << n << ", s = " << s << " has " << size << " vertices, more than vertex_t holds (build with -DSG_INDEX64)" << endl;
+        return -1;
+    }
+    return vertex_t(size);
 }
 
 //Calculates the number of vertices along the edge of a strip of the lattice
 int EdgeVerts(int n, int s)
 {
     int m = 2;
-    int M;
+    int M = m;
     
     //Recursive formula
     for(int i = 0; i < n; i++)
@@ -134,10 +142,10 @@ void SG_LatticeVertList(vector<int> &verts, int s)
 //you can access the layer of the lattice it's in
 void FillLayers(vector<int> &verts, vector<int> &lays)
 {
-    int count = 0;
+    vertex_t count = 0;
     for (int j = 0; j < verts.size(); j++)
     {
-        for(int i = 0; i < verts[j]; i++)
+        for(vertex_t i = 0; i < verts[j]; i++)
         {
             lays[i + count] = j;
         }
@@ -145,36 +153,32 @@ void FillLayers(vector<int> &verts, vector<int> &lays)
     }
 }
 
-//For an arbitrary vertex index dummy, this function assigns its vertex type (1, 2, 3, or 4) in the types vector
-void TypeAssign(vector<int> &type, int dummy, int dum_layer, int numer, int denom, int next_layer_verts, int len, int s)
+//For a vertex on layer dum_layer, numer-th of denom on its triangle, this function returns its vertex type (1, 2, 3, or 4)
+int TypeAssign(int dum_layer, int numer, int denom, int next_layer_verts, int len, int s)
 {
     //Covers type identification of odd numbered layers
     if((dum_layer + 1) % 2 == 0)
     {
         if(numer % 2 == 0)
         {
-            type[dummy] = 2;
-            return;
+            return 2;
         }
         else
         {
-            type[dummy] = 3;
-            return;
+            return 3;
         }
     }
     
     //Covers type identification of the 0th layer
     if(dum_layer == 0)
     {
-        type[dummy] = 1;
-        return;
+        return 1;
     }
     
     //Covers type identification of the bottom layer
     if(dum_layer == len)
     {
-        type[dummy] = 4;
-        return;
+        return 4;
     }
     
     //Covers type identification of the even, non special (not top or bottom) layers
@@ -185,13 +189,11 @@ void TypeAssign(vector<int> &type, int dummy, int dum_layer, int numer, int deno
         {
             if(numer == 1)
             {
-                type[dummy] = 1;
-                return;
+                return 1;
             }
             else
             {
-                type[dummy] = 4;
-                return;
+                return 4;
             }
         }
         // Layer is not special, it is either a 342, 342, ..., layer, or a 34444..., 2, 34444..., 2 ..., layer.
@@ -207,18 +209,15 @@ void TypeAssign(vector<int> &type, int dummy, int dum_layer, int numer, int deno
                 
                 if((numer - 1) % vps == 0)
                 {
-                    type[dummy] = 3;
-                    return;
+                    return 3;
                 }
                 if(numer % vps == 0)
                 {
-                    type[dummy] = 2;
-                    return;
+                    return 2;
                 }
                 else
                 {
-                    type[dummy] = 4;
-                    return;
+                    return 4;
                 }
             }
             
@@ -228,25 +227,23 @@ void TypeAssign(vector<int> &type, int dummy, int dum_layer, int numer, int deno
                 switch ((numer - 1) % 3)
                 {
                     case 0:
-                        type[dummy] = 3;
-                        break;
+                        return 3;
                     case 1:
-                        type[dummy] = 4;
-                        break;
+                        return 4;
                     case 2:
-                        type[dummy] = 2;
-                        break;
+                        return 2;
                 }
             }
         }
     }
+    return 0;
 }
 
 //Calculates depth of index dum into its home layer, dum_layer
 //By PBC, behind the 0th layer is the last layer.
-int Depth(vector<int> &lays, int dum, int dum_layer, int size)
+int Depth(vector<int> &lays, vertex_t dum, int dum_layer, vertex_t size)
 {
-    int j = dum;
+    vertex_t j = dum;
     int track = 0;
     
     do
@@ -264,12 +261,8 @@ int Depth(vector<int> &lays, int dum, int dum_layer, int size)
 }
 
 // given all the information about the site, returns its neighbor in the deisred direction
-int DoEverything(int dum, int n, int s, int size, int d)
+vertex_t DoEverything(vertex_t dum, int n, int s, vertex_t size, int d)
 {
-    int ll = EdgeVerts(n, s);                          //The number of vertices along one edge of a lattice strip
-    int n1; int n2; int n3; int n4; int n5; int n6;    //Neighbor variables
-    int tri_col = 0;                                       //The column of the parallelogram unit cell which dum is in
-    
     //File for output
     ofstream connects;
     connects.open("mathematica_lines.txt", ios::app);
@@ -289,10 +282,6 @@ int DoEverything(int dum, int n, int s, int size, int d)
     //The element itself is the layer that vertex can be found in.
     vector<int> layers(size);
     
-    //Each element slot # is the name of a different vertex.
-    //The element itself is the type of vertex that each vertex is (defined by its connectivity).
-    vector<int> type(size);
-    
     //Fills vector vertices
     SG_VertList(vertices, n);
     
@@ -305,17 +294,58 @@ int DoEverything(int dum, int n, int s, int size, int d)
     //Fills vector layers
     FillLayers(vertices, layers);
     
+    vertex_t nbs[6];
+    SG_Neighbors(dum, n, s, size, vertices, layers, nbs);
+    
+    for(int k = 0; k < 6; k++)
+    {
+        if(nbs[k] != -1)
+        {
+            connects << dum + 1 << " " <<  nbs[k] + 1 << endl;
+        }
+    }
+    
+    switch (d) {
+        case 1:
+            return nbs[0];
+            break;
+        case 2:
+            return nbs[1];
+            break;
+        case 3:
+            return nbs[2];
+            break;
+        case 4:
+            return nbs[3];
+            break;
+        case 5:
+            return nbs[4];
+            break;
+        default:
+            return nbs[5];
+            break;
+    }
+}
+
+// the neighbors of dum in the six directions, worked out from the layer lists of the whole lattice, which are only
+// read, so a builder can fill them in once and call this for every vertex
+void SG_Neighbors(vertex_t dum, int n, int s, vertex_t size, vector<int> &vertices, vector<int> &layers, vertex_t nbs[6])
+{
+    int ll = EdgeVerts(n, s);                          //The number of vertices along one edge of a lattice strip
+    vertex_t n1; vertex_t n2; vertex_t n3; vertex_t n4; vertex_t n5; vertex_t n6;    //Neighbor variables
+    int tri_col = 0;                                       //The column of the parallelogram unit cell which dum is in
+    
     //The layer dum is in
     int test_layer = layers[dum];
     
     //The potential top neighbors of dum
-    vector<int> bachelors(0);
+    vector<vertex_t> bachelors(0);
     
     //The potential bottom neighbors of dum
-    vector<int> bachelorettes(0);
+    vector<vertex_t> bachelorettes(0);
     
     //The other vertices on the same layer and triangle as dum
-    vector<int> buddies(0);
+    vector<vertex_t> buddies(0);
     
     //The number of vertices per triangle in test_layer, its below layer, and its above layer
     int vert_count = vertices[test_layer]/s;
@@ -343,7 +373,7 @@ int DoEverything(int dum, int n, int s, int size, int d)
     double dum_frac =  single_tri_index/(double)vert_count;
     
     //Assigns the vertex type to dum
-    TypeAssign(type, dum, test_layer, single_tri_index, vert_count, vert_count_below, ll, s);
+    int dum_type = TypeAssign(test_layer, single_tri_index, vert_count, vert_count_below, ll, s);
     
     ///////////////////////////////
     //Generic Neighbor Assignment//
@@ -356,7 +386,7 @@ int DoEverything(int dum, int n, int s, int size, int d)
     if(test_layer != 0)
     {
         //On the same triangle as dum, urev, is the upper right edge vertex (where upper is just the layer above dum)
-        int urev = dum - track - s * vert_count_above + tri_col * vert_count_above;
+        vertex_t urev = dum - track - s * vert_count_above + tri_col * vert_count_above;
         
         //This loop fills the bachelors vector with all of the above neighbors that are capable of "reaching down"
         //To have neighbors in the layer below. I.e., all of the above neighbors on dum's triangle which are not type 4.
@@ -370,9 +400,7 @@ int DoEverything(int dum, int n, int s, int size, int d)
             }while(r * vertices[layers[urev]] / s < track3);
             int sup_tri_index = track3 - (r - 1) * vert_count_above;
             
-            TypeAssign(type, urev - i, test_layer - 1, sup_tri_index, vert_count_above, vert_count, ll, s);
-            
-            if(type[urev - i] != 4)
+            if(TypeAssign(test_layer - 1, sup_tri_index, vert_count_above, vert_count, ll, s) != 4)
             {
                 bachelors.push_back(urev - i);
             }
@@ -433,10 +461,10 @@ int DoEverything(int dum, int n, int s, int size, int d)
     //Below Neighbors//
     ///////////////////
     
-    if(test_layer != ll && type[dum] != 4)
+    if(test_layer != ll && dum_type != 4)
     {
         //On the same triangle as dum, brev, is the bottom right edge vertex (where bottom is just the layer below dum)
-        int brev = dum - track + s * vert_count + tri_col * vert_count_below;
+        vertex_t brev = dum - track + s * vert_count + tri_col * vert_count_below;
         
         if((test_layer + 1) % (ll/s) == 0 && test_layer != ll)
         {
@@ -456,9 +484,7 @@ int DoEverything(int dum, int n, int s, int size, int d)
             }while(r * vertices[layers[dum - single_tri_index + 1 + i]] / s < track2);
             int tri_index = track2 - (r - 1) * vert_count;
             
-            TypeAssign(type, dum - single_tri_index + 1 + i, test_layer, tri_index, vert_count, vert_count_below, ll, s);
-            
-            if(type[dum - single_tri_index + 1 + i] != 4)
+            if(TypeAssign(test_layer, tri_index, vert_count, vert_count_below, ll, s) != 4)
             {
                 buddies.push_back(dum - single_tri_index + 1 + i);
                 
@@ -683,11 +709,11 @@ int DoEverything(int dum, int n, int s, int size, int d)
     {
         if(test_layer == 1)
         {
-            if(type[dum] == 3)
+            if(dum_type == 3)
             {
                 n1 = tri_col - 1;
             }
-            if(type[dum] == 2)
+            if(dum_type == 2)
             {
                 n6 = tri_col - 1;
             }
@@ -695,7 +721,7 @@ int DoEverything(int dum, int n, int s, int size, int d)
     }
     
     //Ensures vertex type is respected
-    switch (type[dum])
+    switch (dum_type)
     {
             //All six neighbors
         case 1:
@@ -717,58 +743,14 @@ int DoEverything(int dum, int n, int s, int size, int d)
             break;
     }
     
-    if(n1 != -1)
-    {
-        connects << dum + 1 << " " <<  n1 + 1 << endl;
-    }
-    if(n2 != -1)
-    {
-        connects << dum + 1 << " " <<  n2 + 1 << endl;
-    }
-    if(n3 != -1)
-    {
-        connects << dum + 1 << " " <<  n3 + 1 << endl;
-    }
-    if(n4 != -1)
-    {
-        connects << dum + 1 << " " <<  n4 + 1 << endl;
-    }
-    if(n5 != -1)
-    {
-        connects << dum + 1 << " " <<  n5 + 1 << endl;
-    }
-    if(n6 != -1)
-    {
-        connects << dum + 1 << " " <<  n6 + 1 << endl;
-    }
-    
-    //cout << dum << " " << n1 << " " << n2 << " " << n3 << " " << n4 << " " << n5 << " " << n6 << endl;
+    nbs[0] = n1;
+    nbs[1] = n2;
+    nbs[2] = n3;
+    nbs[3] = n4;
+    nbs[4] = n5;
+    nbs[5] = n6;
     
-    vertices.clear();
-    layers.clear();
-    type.clear();
     bachelors.clear();
     bachelorettes.clear();
     buddies.clear();
-    
-    switch (d) {
-        case 1:
-            return n1;
-            break;
-        case 2:
-            return n2;
-            break;
-        case 3:
-            return n3;
-            break;
-        case 4:
-            return n4;
-            break;
-        case 5:
-            return n5;
-            break;
-        default:
-            return n6;
-            break;
-    }
 }
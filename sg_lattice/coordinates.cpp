@@ -10,73 +10,33 @@
 #include <cmath>
 #include <fstream>
 #include "sg_connections.h"
+#include "one_open_sg.hpp"
+#include "lattice_cache.h"
+#include "sg_coordinates.h"
 
 using namespace std;
 
-void sg_coords(int n, int s)
+// The positions come from the lattice table, which works each one out from the layer and column of the site, so
+// site j of the output is site j of the engine (numbered from 0, layer by layer) and nothing is built point by point
+void sg_coords(int n, int s, bool binary)
 {
+    int size = s == 1 ? TotalVerts_osg(n) : TotalVerts(n, s);
+    shared_ptr<const LatticeView> lattice = sharedlattice(n, s, size, true, ORDER_LAYERS);
 
-    int len = EdgeVerts(n, s)/s;
-    
-    ofstream coordfile;
-    
-    vector<double> x(3);
-    vector<double> y(3);
-    
-    x[0] = 0.0; y[0] = 0.0;
-    x[1] = 0.5; y[1] = sqrt(3)/2;
-    x[2] = 1.0; y[2] = 0.0;
-    
-    int sizex = int(x.size());
-    for(int k = 1; k <= n; k++)
-    {
-        for(int i = 0; i < sizex; i++)
-        {
-            x.push_back(x[i] + pow(2,k-1) * 0.5);
-            y.push_back(y[i] + pow(2,k-1) * sqrt(3)/2);
-            
-            x.push_back(x[i] + pow(2,k-1) * 1);
-            y.push_back(y[i]);
-        }
-        sizex = int(x.size());
+    if (binary) {
+        lattice->writecoords("coords_n" + to_string(n) + "s" + to_string(s) + ".bin", true);
     }
-    
-    //x triangles
-    for(int l = 1; l < s; l++)
-    {
-        for(int i = 0; i < sizex; i++)
-        {
-            x.push_back(x[i] + l * len);
-            y.push_back(y[i]);
-        }
+    else {
+        lattice->writecoords("mathematica_coords.txt", false);
     }
-    sizex = int(x.size());
-    
-    //y triangles
-    for(int l = 1; l < s; l++)
-    {
-        for(int i = 0; i < sizex; i++)
-        {
-            x.push_back(x[i] + l * len/2);
-            y.push_back(y[i] - len * l * sqrt(3)/2);
-        }
-    }
-    
-    //Output
-    coordfile.open("mathematica_coords.txt");
-    coordfile << "{";
-    for(int j = 0; j <= x.size() - 1; j++)
-    {
-        if(j == x.size() - 1)
-        {
-            coordfile << "{" << x[j] << ", " << y[j] << "}}" << endl;
-        }
-        else
-        {
-            coordfile << "{" << x[j] << ", " << y[j] << "}, ";
-        }
-    }
-    coordfile.close();
-    
     return;
 }
+
+void sg_positions(int n, int s, vector<float> &x, vector<float> &y)
+{
+    int size = s == 1 ? TotalVerts_osg(n) : TotalVerts(n, s);
+    shared_ptr<const LatticeView> lattice = sharedlattice(n, s, size, true, ORDER_LAYERS);
+
+    x.assign(lattice->x(), lattice->x() + size);
+    y.assign(lattice->y(), lattice->y() + size);
+}
@@ -0,0 +1,103 @@
+//
+// Lists with room for a fixed number of entries, kept in place in a SiteStore, for the pebble graph and bonds of a SiteRP
+//
+
+#ifndef PEBBLEGAMETEST_FIXED_LIST_H
+#define PEBBLEGAMETEST_FIXED_LIST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include "site_store.h"
+
+// A FixedList is a view of a list whose entries and length live elsewhere, with room for capacity entries. It has
+// the parts of the std::vector interface the engine uses, with plain pointers for iterators, so that the lists
+// can be carved out of a SiteStore and paged in from its file like the flat per-site arrays. Copying a FixedList
+// copies the view, assigning to one copies the entries. A full list refuses any more entries and says so
+template <class T, class L>
+class FixedList {
+public:
+    FixedList(T *entries, L *length, size_t capacity) : entries(entries), length(length), capacity(capacity) {}
+    FixedList(const FixedList &other) = default;
+    FixedList &operator=(const FixedList &other) {
+        assign(other.begin(), other.end());
+        return *this;
+    }
+
+    size_t size() const { return *length; }
+    bool empty() const { return *length == 0; }
+    T *begin() const { return entries; }
+    T *end() const { return entries + *length; }
+    T &operator[](size_t k) const { return entries[k]; }
+    T &at(size_t k) const { return entries[k]; }
+    T &back() const { return entries[*length - 1]; }
+    bool operator==(const FixedList &other) const {
+        return size() == other.size() && std::equal(begin(), end(), other.begin());
+    }
+
+    void clear() { *length = 0; }
+    void pop_back() { (*length)--; }
+    bool push_back(const T &value) {
+        if (*length == capacity) {
+            std::cout << "A list with room for " << capacity << " entries was given one more.\n";
+            return false;
+        }
+        new (entries + *length) T(value);
+        (*length)++;
+        return true;
+    }
+    T *erase(T *at) {
+        std::copy(at + 1, end(), at);
+        (*length)--;
+        return at;
+    }
+    T *insert(T *at, const T &value) {
+        if (at == end()) {
+            push_back(value);
+            return at;
+        }
+        if (!push_back(back())) {
+            return at;
+        }
+        std::copy_backward(at, end() - 2, end() - 1);
+        *at = value;
+        return at;
+    }
+    template <class It> void insert(T *at, It first, It last) {    // only at the end
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+    template <class It> void assign(It first, It last) {
+        clear();
+        for (; first != last; ++first) {
+            push_back(T(*first));
+        }
+    }
+
+private:
+    T *entries;
+    L *length;
+    size_t capacity;
+};
+
+// SiteLists holds a list of at most width entries for every site, the entries of site i starting at width * i, in
+// two arrays taken from a SiteStore. bytes() is what they take, padding included
+template <class T>
+class SiteLists {
+public:
+    SiteLists(SiteStore &store, size_t numsites, size_t width)
+        : entries(store.take<T>(numsites * width)), lengths(store.take<uint8_t>(numsites)), width(width) {}
+    FixedList<T, uint8_t> operator[](size_t i) const { return FixedList<T, uint8_t>(entries + width * i, lengths + i, width); }
+    size_t room() const { return width; }
+    static size_t bytes(size_t numsites, size_t width) { return numsites * width * sizeof(T) + alignof(T) + numsites; }
+
+private:
+    T *entries;
+    uint8_t *lengths;
+    size_t width;
+};
+
+#endif //PEBBLEGAMETEST_FIXED_LIST_H
@@ -0,0 +1,424 @@
+//
+// The neighbor table and geometry of an SG lattice, built once and kept on disk for every later run to map
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stack>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lattice_cache.h"
+#include "snapshot.h"
+#include "sg_connections.h"
+#include "one_open_sg.hpp"
+
+// Every section of the version read is checked to be present, to hold the number of entries the lattice needs
+// and to lie inside the file, so that a file cut short can't fault inside the mapping later on
+static bool sectionsfit(const LatticeHeader &h, uint64_t length)
+{
+    const uint64_t bytes[] = {sizeof(vertex_t), sizeof(uint8_t), sizeof(int32_t), sizeof(int32_t), sizeof(float),
+                              sizeof(float), sizeof(vertex_t), sizeof(vertex_t), sizeof(uint8_t), sizeof(uint8_t)};
+    for (int section = 0; section <= LATTICE_DEGREE; section++) {
+        uint64_t count = section == LATTICE_NEIGHBORS ? 6 * uint64_t(h.size) : uint64_t(h.size);
+        uint64_t offset = h.offset[section];
+        if (offset == 0 || h.count[section] != count || offset % bytes[section] != 0 || offset > length ||
+            count > (length - offset) / bytes[section]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LatticeView::LatticeView()
+{
+    base = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+LatticeView::~LatticeView()
+{
+    close();
+}
+
+bool LatticeView::open(const std::string &filename, int n, int s, vertex_t size, int order)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;                           // not built yet, which isn't worth a message
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof(LatticeHeader)) {
+        std::cout << "The lattice file " << filename << " is too short to hold a header.\n";
+        ::close(fd);
+        return false;
+    }
+
+    void *region = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (region == MAP_FAILED) {
+        std::cout << "I couldn't map the lattice file " << filename << ".\n";
+        return false;
+    }
+    base = (const char *) region;
+    length = st.st_size;
+    mapped = true;
+
+    const LatticeHeader &h = header();
+    if (memcmp(h.magic, LATTICE_MAGIC, sizeof(LATTICE_MAGIC)) != 0 || h.byteorder != SNAPSHOT_BYTEORDER ||
+        h.version != LATTICE_VERSION || h.headerbytes != sizeof(LatticeHeader) || h.indexbytes != sizeof(vertex_t)) {
+        std::cout << "The file " << filename << " isn't a lattice file this version can read.\n";
+        close();
+        return false;
+    }
+    if (h.n != n || h.s != s || h.size != size || h.boundary != (s == 1 ? BOUNDARY_OPEN : BOUNDARY_PERIODIC) ||
+        h.order != order) {
+        std::cout << "The lattice file " << filename << " holds a different lattice.\n";
+        close();
+        return false;
+    }
+    if (!sectionsfit(h, length)) {
+        std::cout << "The lattice file " << filename << " is truncated or damaged, a section runs past its end.\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+// The neighbors are the ones choosedir_sg used to work out a site at a time, and the columns are found the way
+// SiteRP::findcolumns does, by walking the lattice from site 0. A step to the right or up and to the right moves
+// one column on, and down a layer moves half a bond to the right, which gives the positions
+bool LatticeView::build(int n, int s, vertex_t size, int threads, int order)
+{
+    close();
+
+    int ll = s == 1 ? EdgeVerts_osg(n) : EdgeVerts(n, s);
+    std::vector<int> vertices(3);
+    vertices[0] = 1;
+    vertices[1] = 2;
+    vertices[2] = 3;
+    SG_VertList(vertices, n);
+    int striplayers = int(vertices.size()) - 1;
+    if (s != 1) {
+        SG_StripVertList(vertices, s);
+        SG_LatticeVertList(vertices, s);
+    }
+    std::vector<int> layers(size + 2, -1);      // SG_Neighbors looks up to two sites past the one it is given
+    FillLayers(vertices, layers);
+
+    uint64_t sectionbytes[NUM_LATTICE_SECTIONS_MAX] = {};
+    sectionbytes[LATTICE_NEIGHBORS] = 6 * sizeof(vertex_t) * uint64_t(size);
+    sectionbytes[LATTICE_TYPE] = sizeof(uint8_t) * uint64_t(size);
+    sectionbytes[LATTICE_LAYER] = sizeof(int32_t) * uint64_t(size);
+    sectionbytes[LATTICE_COLUMN] = sizeof(int32_t) * uint64_t(size);
+    sectionbytes[LATTICE_X] = sizeof(float) * uint64_t(size);
+    sectionbytes[LATTICE_Y] = sizeof(float) * uint64_t(size);
+    sectionbytes[LATTICE_LEGACY] = sizeof(vertex_t) * uint64_t(size);
+    sectionbytes[LATTICE_SITE] = sizeof(vertex_t) * uint64_t(size);
+    sectionbytes[LATTICE_MASK] = sizeof(uint8_t) * uint64_t(size);
+    sectionbytes[LATTICE_DEGREE] = sizeof(uint8_t) * uint64_t(size);
+
+    LatticeHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LATTICE_MAGIC, sizeof(LATTICE_MAGIC));
+    h.version = LATTICE_VERSION;
+    h.byteorder = SNAPSHOT_BYTEORDER;
+    h.headerbytes = sizeof(LatticeHeader);
+    h.n = n;
+    h.s = s;
+    h.size = size;
+    h.ll = ll;
+    h.boundary = s == 1 ? BOUNDARY_OPEN : BOUNDARY_PERIODIC;
+    h.order = order;
+    h.indexbytes = sizeof(vertex_t);
+    uint64_t end = (sizeof(LatticeHeader) + 7) / 8 * 8;
+    for (int section = 0; section < NUM_LATTICE_SECTIONS_MAX; section++) {
+        if (sectionbytes[section] == 0) {
+            continue;
+        }
+        h.offset[section] = end;
+        h.count[section] = section == LATTICE_NEIGHBORS ? 6 * uint64_t(size) : uint64_t(size);
+        end += (sectionbytes[section] + 7) / 8 * 8;
+    }
+
+    owned.assign(end / 8, 0);
+    base = (const char *) owned.data();
+    length = end;
+    memcpy(owned.data(), &h, sizeof(h));
+    vertex_t *nbs = (vertex_t *) at(LATTICE_NEIGHBORS);
+    uint8_t *types = (uint8_t *) at(LATTICE_TYPE);
+    int32_t *layer = (int32_t *) at(LATTICE_LAYER);
+    int32_t *column = (int32_t *) at(LATTICE_COLUMN);
+    float *x = (float *) at(LATTICE_X);
+    float *y = (float *) at(LATTICE_Y);
+    vertex_t *legacy = (vertex_t *) at(LATTICE_LEGACY);
+    vertex_t *numbered = (vertex_t *) at(LATTICE_SITE);
+
+    // the first site of every strip, the top layer going with the first strip and the periodic bottom one with the last
+    std::vector<vertex_t> stripstart(1, 0);
+    for (vertex_t site = 1; site < size; site++) {
+        int strip = layers[site] == 0 ? 0 : std::min(s - 1, (layers[site] - 1) / striplayers);
+        if (strip != stripstart.size() - 1) {
+            stripstart.push_back(site);
+        }
+    }
+    stripstart.push_back(size);
+    int numstrips = int(stripstart.size()) - 1;
+    if (threads <= 0) {
+        threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+    threads = std::min(threads, numstrips);
+
+    // the layer lists are only read, and the types are worked out as they are needed, so the sites can go in any
+    // order with no scratch per thread
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        vertex_t first = stripstart[t * numstrips / threads];
+        vertex_t last = stripstart[(t + 1) * numstrips / threads];
+        workers.push_back(std::thread([&, first, last] {
+            for (vertex_t site = first; site < last; site++) {
+                if (s == 1) {
+                    for (int d = 1; d <= 6; d++) {
+                        nbs[6 * site + d - 1] = DoEverything_osg(site, n, size, d);
+                    }
+                }
+                else {
+                    vertex_t found[6];
+                    SG_Neighbors(site, n, s, size, vertices, layers, found);
+                    std::copy(found, found + 6, nbs + 6 * site);
+                }
+                const vertex_t *nb = nbs + 6 * site;
+                // the order addtricluster2_sg tells the types apart in
+                types[site] = (nb[0] == -1 && nb[1] == -1) ? 2 : (nb[2] == -1 && nb[3] == -1) ? 4 :
+                              (nb[4] == -1 && nb[5] == -1) ? 3 : 1;
+                layer[site] = layers[site];
+                column[site] = -1;
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+
+    // the columns are stitched together across the strips by the walk, which is one pass over the table
+    std::stack<vertex_t> tovisit;
+    for (vertex_t start = 0; start < size; start++) {
+        if (column[start] != -1) {
+            continue;
+        }
+        column[start] = 0;
+        tovisit.push(start);
+        while (!tovisit.empty()) {
+            vertex_t i = tovisit.top();
+            tovisit.pop();
+            for (int d = 1; d <= 6; d++) {
+                vertex_t j = nbs[6 * i + d - 1];
+                if (j == -1 || column[j] != -1) {
+                    continue;
+                }
+                int step = (d == 1 || d == 2) ? 1 : ((d == 4 || d == 5) ? -1 : 0);
+                column[j] = s == 1 ? column[i] + step : (column[i] + step + ll) % ll;
+                tovisit.push(j);
+            }
+        }
+    }
+    for (vertex_t i = 0; i < size; i++) {
+        x[i] = float(column[i] + 0.5 * layer[i]);
+        y[i] = float(-0.5 * sqrt(3.0) * layer[i]);
+        legacy[i] = i;
+        numbered[i] = i;
+    }
+    if (order == ORDER_MORTON) {
+        renumber(morton());
+    }
+
+    // the masks only depend on which neighbors there are, so they are the same in either order
+    uint8_t *mask = (uint8_t *) at(LATTICE_MASK);
+    uint8_t *degree = (uint8_t *) at(LATTICE_DEGREE);
+    for (vertex_t i = 0; i < size; i++) {
+        mask[i] = 0;
+        degree[i] = 0;
+        for (int d = 1; d <= 6; d++) {
+            if (neighbor(i, d) != -1) {
+                mask[i] |= uint8_t(1 << (d - 1));
+                degree[i]++;
+            }
+        }
+    }
+    return true;
+}
+
+// the sites in the order of the Z-order curve over (column, layer), which interleaves the bits of the two, the
+// current number breaking ties
+std::vector<vertex_t> LatticeView::morton() const
+{
+    std::vector<std::pair<uint64_t, vertex_t> > keys(size());
+    for (vertex_t i = 0; i < size(); i++) {
+        uint64_t key = 0;
+        uint32_t c = uint32_t(column()[i] < 0 ? 0 : column()[i]);
+        uint32_t r = uint32_t(layer()[i]);
+        for (int bit = 0; bit < 32; bit++) {
+            key |= uint64_t((c >> bit) & 1) << (2 * bit);
+            key |= uint64_t((r >> bit) & 1) << (2 * bit + 1);
+        }
+        keys[i] = std::make_pair(key, i);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<vertex_t> sequence(size());
+    for (vertex_t i = 0; i < size(); i++) {
+        sequence[i] = keys[i].second;
+    }
+    return sequence;
+}
+
+// rewrites every section so that site i is the one that was numbered sequence[i], neighbors included
+void LatticeView::renumber(const std::vector<vertex_t> &sequence)
+{
+    vertex_t numsites = size();
+    std::vector<vertex_t> was(neighbors(), neighbors() + 6 * numsites);
+    std::vector<uint8_t> types(type(), type() + numsites);
+    std::vector<int> layers(layer(), layer() + numsites);
+    std::vector<int> columns(column(), column() + numsites);
+    std::vector<float> xs(x(), x() + numsites);
+    std::vector<float> ys(y(), y() + numsites);
+    std::vector<vertex_t> legacies(legacy(), legacy() + numsites);
+
+    vertex_t *newsite = (vertex_t *) at(LATTICE_SITE);
+    for (vertex_t i = 0; i < numsites; i++) {
+        newsite[legacies[sequence[i]]] = i;
+    }
+    for (vertex_t i = 0; i < numsites; i++) {
+        vertex_t old = sequence[i];
+        for (int d = 0; d < 6; d++) {
+            vertex_t nb = was[6 * old + d];
+            ((vertex_t *) at(LATTICE_NEIGHBORS))[6 * i + d] = nb == -1 ? -1 : newsite[legacies[nb]];
+        }
+        ((uint8_t *) at(LATTICE_TYPE))[i] = types[old];
+        ((int32_t *) at(LATTICE_LAYER))[i] = layers[old];
+        ((int32_t *) at(LATTICE_COLUMN))[i] = columns[old];
+        ((float *) at(LATTICE_X))[i] = xs[old];
+        ((float *) at(LATTICE_Y))[i] = ys[old];
+        ((vertex_t *) at(LATTICE_LEGACY))[i] = legacies[old];
+    }
+}
+
+bool LatticeView::save(const std::string &filename) const
+{
+    if (!isopen()) {
+        return false;
+    }
+    // under a name of its own first, so a run starting meanwhile never maps half a file
+    std::string temporary = filename + ".tmp" + std::to_string(getpid());
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(base, length);
+    out.close();
+    if (!out || rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::cout << "I couldn't write the lattice file " << filename << ".\n";
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+void LatticeView::close()
+{
+    if (mapped) {
+        munmap((void *) base, length);
+    }
+    owned.clear();
+    base = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+void LatticeView::writelines(const std::string &filename) const
+{
+    std::ofstream connects(filename);
+    for (vertex_t j = 0; j < size(); j++) {
+        vertex_t i = site()[j];
+        for (int d = 1; d <= 6; d++) {
+            if (neighbor(i, d) != -1) {
+                connects << j + 1 << " " << legacy()[neighbor(i, d)] + 1 << std::endl;
+            }
+        }
+    }
+}
+
+// The text goes out through a buffer of its own in large writes, and the positions are only read from the table.
+// Adding 0 turns the -0 of the top layer into 0
+bool LatticeView::writecoords(const std::string &filename, bool binary) const
+{
+    std::ofstream out(filename, binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+    if (!out) {
+        std::cout << "I couldn't open " << filename << " to write the site positions.\n";
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    size_t used = 0;
+    if (!binary) {
+        buffer[used++] = '{';
+    }
+    for (vertex_t j = 0; j < size(); j++) {
+        vertex_t i = site()[j];
+        if (binary) {
+            float position[2] = {x()[i], y()[i]};
+            memcpy(buffer.data() + used, position, sizeof(position));
+            used += sizeof(position);
+        }
+        else {
+            used += snprintf(buffer.data() + used, 64, "{%g, %g}%s", x()[i] + 0.0f, y()[i] + 0.0f, j == size() - 1 ? "}\n" : ", ");
+        }
+        if (used > buffer.size() - 64) {
+            out.write(buffer.data(), used);
+            used = 0;
+        }
+    }
+    out.write(buffer.data(), used);
+    out.close();
+    if (!out) {
+        std::cout << "I couldn't write the site positions to " << filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+std::string latticename(int n, int s, int order)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "lattice_n%ds%d_%s%s.bin", n, s, s == 1 ? "open" : "pbc", order == ORDER_MORTON ? "_morton" : "");
+    return name;
+}
+
+std::shared_ptr<const LatticeView> sharedlattice(int n, int s, vertex_t size, bool usefile, int order)
+{
+    static std::mutex lock;
+    static std::map<std::vector<int>, std::shared_ptr<const LatticeView> > lattices;
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<const LatticeView> &known = lattices[std::vector<int>{n, s, order}];
+    if (known && known->size() == size) {
+        return known;
+    }
+
+    std::shared_ptr<LatticeView> lattice = std::make_shared<LatticeView>();
+    std::string filename = latticename(n, s, order);
+    if (!usefile || !lattice->open(filename, n, s, size, order)) {
+        lattice->build(n, s, size, 0, order);
+        if (usefile && lattice->save(filename) && !lattice->open(filename, n, s, size, order)) {
+            lattice->build(n, s, size, 0, order);
+        }
+    }
+    known = lattice;
+    return known;
+}
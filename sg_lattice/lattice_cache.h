@@ -0,0 +1,128 @@
+//
+// The neighbor table and geometry of an SG lattice, built once and kept on disk for every later run to map
+//
+
+#ifndef PEBBLEGAMETEST_LATTICE_CACHE_H
+#define PEBBLEGAMETEST_LATTICE_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "vertex_index.h"
+
+// A lattice file is laid out like a snapshot (snapshot.h): the header below followed by 8-byte aligned sections
+// that can be used in place once the file is memory mapped. It is keyed by n, s, the boundary conditions and the
+// order the sites are numbered in, which the file name carries too, and a file whose key or version doesn't match
+// is built again. Site numbers are vertex_t (vertex_index.h), whose width the header records, so a file written by a
+// 64-bit index build is built again by a 32-bit one and the other way around.
+// All numbers are in the byte order of the machine that wrote the file.
+
+static const char LATTICE_MAGIC[8] = {'S', 'R', 'P', 'L', 'A', 'T', 'T', '\0'};
+static const uint32_t LATTICE_VERSION = 4;
+
+enum LatticeBoundary {
+    BOUNDARY_PERIODIC = 0,      // a lattice of s by s SGs on a torus
+    BOUNDARY_OPEN = 1           // a single SG (s = 1) with open edges
+};
+
+// The sites of the lattice are numbered layer by layer (the legacy numbering every output file uses), so the
+// neighbors of a site in the layers above and below are a whole layer of sites away from it. In Morton order they
+// are numbered along a Z-order curve over (column, layer) instead, so that sites close together on the lattice are
+// close together in memory, and pebble searches and decompositions stay on fewer cache lines
+enum LatticeOrder {
+    ORDER_LAYERS = 0,
+    ORDER_MORTON = 1
+};
+
+enum LatticeSection {
+    LATTICE_NEIGHBORS = 0,      // vertex_t[6 * size]  the neighbor of each site in directions 1 to 6, -1 if there is none
+    LATTICE_TYPE,               // uint8[size]  vertex type 1 to 4, from which pair of directions is missing
+    LATTICE_LAYER,              // int32[size]  the layer (row) of each site
+    LATTICE_COLUMN,             // int32[size]  the column of each site, 0 to ll - 1 around the lattice
+    LATTICE_X,                  // float[size]  position of each site, in units of the bond length
+    LATTICE_Y,                  // float[size]
+    LATTICE_LEGACY,             // vertex_t[size]  the layer by layer number of each site (version 2 on)
+    LATTICE_SITE,               // vertex_t[size]  the site with each layer by layer number (version 2 on)
+    LATTICE_MASK,               // uint8[size]  bit d - 1 set if the site has a neighbor in direction d (version 3 on)
+    LATTICE_DEGREE,             // uint8[size]  the number of neighbors of each site, 4 or 6 (version 3 on)
+    NUM_LATTICE_SECTIONS_MAX = 16
+};
+
+struct LatticeHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    uint64_t headerbytes;
+
+    int32_t n;
+    int32_t s;
+    int64_t size;
+    int32_t ll;
+    int32_t boundary;
+    int32_t order;
+    int32_t indexbytes;         // sizeof(vertex_t) (version 4 on)
+
+    uint64_t offset[NUM_LATTICE_SECTIONS_MAX];
+    uint64_t count[NUM_LATTICE_SECTIONS_MAX];
+};
+
+// LatticeView holds a lattice either mapped read-only from its file or, when it was just built, in memory in the
+// same layout. Nothing in it changes once it is open, so any number of engines and threads can share one
+class LatticeView {
+public:
+    LatticeView();
+    ~LatticeView();
+
+    bool open(const std::string &filename, int n, int s, vertex_t size, int order);  // maps the file, false if it isn't this lattice
+    // works the lattice out from scratch on threads threads, all the cores for 0. Each takes a run of whole strips
+    // of SGs (sites are numbered layer by layer, so a strip is a run of consecutive sites), and the table comes out
+    // the same whatever the number of threads. It is renumbered in the given order at the end
+    bool build(int n, int s, vertex_t size, int threads = 0, int order = ORDER_LAYERS);
+    bool save(const std::string &filename) const;                       // writes it under a temporary name and renames it
+    void close();
+    bool isopen() const { return base != nullptr; }
+    bool ismapped() const { return mapped; }
+
+    const LatticeHeader &header() const { return *(const LatticeHeader *) base; }
+    vertex_t size() const { return vertex_t(header().size); }
+    vertex_t neighbor(vertex_t i, int d) const { return neighbors()[6 * i + d - 1]; }
+
+    const vertex_t *neighbors() const { return (const vertex_t *) at(LATTICE_NEIGHBORS); }
+    const uint8_t *type() const { return (const uint8_t *) at(LATTICE_TYPE); }
+    const int32_t *layer() const { return (const int32_t *) at(LATTICE_LAYER); }
+    const int32_t *column() const { return (const int32_t *) at(LATTICE_COLUMN); }
+    const float *x() const { return (const float *) at(LATTICE_X); }
+    const float *y() const { return (const float *) at(LATTICE_Y); }
+    const vertex_t *legacy() const { return (const vertex_t *) at(LATTICE_LEGACY); }
+    const vertex_t *site() const { return (const vertex_t *) at(LATTICE_SITE); }
+    const uint8_t *mask() const { return (const uint8_t *) at(LATTICE_MASK); }
+    const uint8_t *degree() const { return (const uint8_t *) at(LATTICE_DEGREE); }
+
+    // mathematica_lines.txt style, every pair of sites that may share a bond, numbered from 1 layer by layer
+    void writelines(const std::string &filename) const;
+    // the position of every site layer by layer, streamed as a Mathematica list {{x, y}, ...} like
+    // mathematica_coords.txt, or with binary as x, y float pairs with nothing around them
+    bool writecoords(const std::string &filename, bool binary) const;
+
+private:
+    const char *at(LatticeSection section) const { return base + header().offset[section]; }
+    std::vector<vertex_t> morton() const;
+    void renumber(const std::vector<vertex_t> &sequence);
+
+    const char *base;
+    size_t length;
+    bool mapped;
+    std::vector<uint64_t> owned;    // the built lattice, in 8-byte words so every section stays aligned
+};
+
+// lattice_n{n}s{s}_pbc.bin, or _open.bin for a single SG, with _morton before .bin in Morton order
+std::string latticename(int n, int s, int order);
+
+// the lattice of size sites, numbered in the given order, that every engine of the process shares. It is mapped from
+// latticename(n, s, order) in the working directory, which is built and written first if it isn't there or is out
+// of date. Without usefile it is built in memory and nothing is read or written
+std::shared_ptr<const LatticeView> sharedlattice(int n, int s, vertex_t size, bool usefile, int order);
+
+#endif //PEBBLEGAMETEST_LATTICE_CACHE_H
@@ -14,22 +14,30 @@
 using namespace std;
 
 //Calculates the total number of vertices in the system
-int TotalVerts_osg(int n)
+//in 64-bit integers, like TotalVerts, -1 if vertex_t can't hold it
+vertex_t TotalVerts_osg(int n)
 {
-    int var = 0;
+    int64_t var = 0;
+    int64_t power = 1;
     
     for(int k = 0; k <= n; k++)
     {
-        var += pow(3,k) + 2;
+        var += power + 2;
+        power *= 3;
     }
-    return var;
+    if(var > VERTEX_MAX)
+    {
+        cout << "A single SG of n = " << n << " has " << var << " vertices, more than vertex_t holds (build with -DSG_INDEX64)" << endl;
+        return -1;
+    }
+    return vertex_t(var);
 }
 
 //Calculates the number of vertices along the edge of a strip of the lattice
 int EdgeVerts_osg(int n)
 {
     int m = 2;
-    int M;
+    int M = m;
     
     //Recursive formula
     for(int i = 0; i < n; i++)
@@ -49,10 +57,10 @@ int EdgeVerts_osg(int n)
 //you can access the layer of the lattice it's in
 void FillLayers_osg(vector<int> &verts, vector<int> &lays)
 {
-    int count = 0;
+    vertex_t count = 0;
     for (int j = 0; j < verts.size(); j++)
     {
-        for(int i = 0; i < verts[j]; i++)
+        for(vertex_t i = 0; i < verts[j]; i++)
         {
             lays[i + count] = j;
         }
@@ -61,7 +69,7 @@ void FillLayers_osg(vector<int> &verts, vector<int> &lays)
 }
 
 //For an arbitrary vertex index dummy, this function assigns its vertex type (1, 2, 3, or 4) in the types vector
-void TypeAssign_osg(vector<int> &type, int dummy, int dum_layer, int numer, int denom, int next_layer_verts, int len)
+void TypeAssign_osg(vector<int> &type, vertex_t dummy, int dum_layer, int numer, int denom, int next_layer_verts, int len)
 {
     //Covers type identification of odd numbered layers
     if((dum_layer + 1) % 2 == 0)
@@ -152,9 +160,9 @@ void TypeAssign_osg(vector<int> &type, int dummy, int dum_layer, int numer, int
 
 //Calculates depth of index dum into its home layer, dum_layer
 //By PBC, behind the 0th layer is the last layer.
-int Depth_osg(vector<int> &lays, int dum, int dum_layer, int size)
+int Depth_osg(vector<int> &lays, vertex_t dum, int dum_layer, vertex_t size)
 {
-    int j = dum;
+    vertex_t j = dum;
     int track = 0;
     
     do
@@ -171,10 +179,10 @@ int Depth_osg(vector<int> &lays, int dum, int dum_layer, int size)
     return track;
 }
 
-int DoEverything_osg(int dum, int n, int size, int d)
+vertex_t DoEverything_osg(vertex_t dum, int n, vertex_t size, int d)
 {
     int ll = EdgeVerts_osg(n);                          //The number of vertices along one edge of a lattice strip
-    int n1; int n2; int n3; int n4; int n5; int n6;    //Neighbor variables
+    vertex_t n1; vertex_t n2; vertex_t n3; vertex_t n4; vertex_t n5; vertex_t n6;    //Neighbor variables
   
     //Each element slot # corresponds to a different layer.
     //The element itself is the number of vertices on that layer.
@@ -205,13 +213,13 @@ int DoEverything_osg(int dum, int n, int size, int d)
     int test_layer = layers[dum];
     
     //The potential top neighbors of dum
-    vector<int> bachelors(0);
+    vector<vertex_t> bachelors(0);
     
     //The potential bottom neighbors of dum
-    vector<int> bachelorettes(0);
+    vector<vertex_t> bachelorettes(0);
     
     //The other vertices on the same layer and triangle as dum
-    vector<int> buddies(0);
+    vector<vertex_t> buddies(0);
     
     //The number of vertices per triangle in test_layer, its below layer, and its above layer
     int vert_count = vertices[test_layer];
@@ -247,7 +255,7 @@ int DoEverything_osg(int dum, int n, int size, int d)
     if(test_layer != 0)
     {
         //On the same triangle as dum, urev, is the upper right edge vertex (where upper is just the layer above dum)
-        int urev = dum - track - vert_count_above + vert_count_above;
+        vertex_t urev = dum - track - vert_count_above + vert_count_above;
         
         //This loop fills the bachelors vector with all of the above neighbors that are capable of "reaching down"
         //To have neighbors in the layer below. I.e., all of the above neighbors on dum's triangle which are not type 4.
@@ -334,7 +342,7 @@ int DoEverything_osg(int dum, int n, int size, int d)
     if(test_layer + 1 != ll && type[dum] != 4)
     {
         //On the same triangle as dum, brev, is the bottom right edge vertex (where bottom is just the layer below dum)
-        int brev = dum - track + vert_count + vert_count_below;
+        vertex_t brev = dum - track + vert_count + vert_count_below;
         
         if((test_layer + 1) % (ll) == 0 && test_layer != ll)
         {
@@ -6,9 +6,10 @@
 #ifndef one_open_sg_hpp
 #define one_open_sg_hpp
 #include <vector>
+#include "vertex_index.h"
 
-//Returns the total number of vertices in the latice
-int TotalVerts_osg(int N);
+//Returns the total number of vertices in the latice, worked out exactly, -1 if vertex_t can't hold it
+vertex_t TotalVerts_osg(int N);
 
 //Returns the number of vertices along the bottom edge of the unit cell
 int EdgeVerts_osg(int N);
@@ -17,12 +18,12 @@ int EdgeVerts_osg(int N);
 void FillLayers_osg(std::vector<int> &VERTICES, std::vector<int> &LAYERS);
 
 //Determines what type of vertex dum is and records it in the vector type under dum's index
-void TypeAssign_osg(std::vector <int> &TYPE, int DUM, int TEST_LAYER, int SINGLE_TRI_INDEX, int VERT_COUNT, int VERT_COUNT_BELOW, int LL);
+void TypeAssign_osg(std::vector <int> &TYPE, vertex_t DUM, int TEST_LAYER, int SINGLE_TRI_INDEX, int VERT_COUNT, int VERT_COUNT_BELOW, int LL);
 
 //Returns how many vertices far right into a layer dum is
-int Depth_osg(std::vector<int> &LAYERS, int DUM, int DUM_LAYER, int SIZE);
+int Depth_osg(std::vector<int> &LAYERS, vertex_t DUM, int DUM_LAYER, vertex_t SIZE);
 
 //Defines important quantities and assigns neighbors
-int DoEverything_osg(int DUM, int N, int SIZE, int D);
+vertex_t DoEverything_osg(vertex_t DUM, int N, vertex_t SIZE, int D);
 
 #endif
@@ -0,0 +1,344 @@
+//
+// Online aggregation of the critical packing and volume fractions found in each trial
+//
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include "pc_stats.h"
+
+// add includes x using the single pass update of the mean and central moments
+void Moments::add(double x)
+{
+    if (count == 0) {
+        min = max = x;
+    }
+    else {
+        if (x < min) { min = x; }
+        if (x > max) { max = x; }
+    }
+
+    double n1 = count;
+    count++;
+    double nn = count;
+    double delta = x - mean;
+    double delta_n = delta / nn;
+    double delta_n2 = delta_n * delta_n;
+    double term1 = delta * delta_n * n1;
+
+    mean += delta_n;
+    m4 += term1 * delta_n2 * (nn * nn - 3 * nn + 3) + 6 * delta_n2 * m2 - 4 * delta_n * m3;
+    m3 += term1 * delta_n * (nn - 2) - 3 * delta_n * m2;
+    m2 += term1;
+}
+
+// merge combines two disjoint samples with the pairwise update formulas for the central moments
+void Moments::merge(const Moments &other)
+{
+    if (other.count == 0) { return; }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+
+    double na = count;
+    double nb = other.count;
+    double nn = na + nb;
+    double delta = other.mean - mean;
+    double delta2 = delta * delta;
+    double delta3 = delta2 * delta;
+    double delta4 = delta2 * delta2;
+
+    double newm4 = m4 + other.m4 + delta4 * na * nb * (na * na - na * nb + nb * nb) / (nn * nn * nn)
+                   + 6 * delta2 * (na * na * other.m2 + nb * nb * m2) / (nn * nn)
+                   + 4 * delta * (na * other.m3 - nb * m3) / nn;
+    double newm3 = m3 + other.m3 + delta3 * na * nb * (na - nb) / (nn * nn)
+                   + 3 * delta * (na * other.m2 - nb * m2) / nn;
+    double newm2 = m2 + other.m2 + delta2 * na * nb / nn;
+
+    mean += delta * nb / nn;
+    m2 = newm2;
+    m3 = newm3;
+    m4 = newm4;
+    count += other.count;
+    if (other.min < min) { min = other.min; }
+    if (other.max > max) { max = other.max; }
+}
+
+double Moments::variance() const
+{
+    if (count < 2) { return 0.0; }
+    return m2 / (count - 1);
+}
+
+double Moments::stderror() const
+{
+    if (count < 2) { return std::numeric_limits<double>::infinity(); }
+    return sqrt(variance() / count);
+}
+
+double Moments::skewness() const
+{
+    if (count < 2 || m2 == 0.0) { return 0.0; }
+    return sqrt(double(count)) * m3 / pow(m2, 1.5);
+}
+
+double Moments::kurtosis() const
+{
+    if (count < 2 || m2 == 0.0) { return 0.0; }
+    return count * m4 / (m2 * m2) - 3.0;
+}
+
+Histogram::Histogram(int numbins, double lo_input, double hi_input)
+{
+    lo = lo_input;
+    hi = hi_input;
+    bins.assign(numbins, 0);
+}
+
+void Histogram::add(double x)
+{
+    int numbins = int(bins.size());
+    int b = int((x - lo) / (hi - lo) * numbins);
+    if (b < 0) { b = 0; }
+    if (b >= numbins) { b = numbins - 1; }
+    bins[b]++;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    if (other.bins.size() != bins.size() || other.lo != lo || other.hi != hi) {
+        std::cout << "I tried to merge two histograms with different binning, the second one was skipped.\n";
+        return;
+    }
+    for (int b = 0; b < bins.size(); b++) {
+        bins[b] += other.bins[b];
+    }
+}
+
+void SizeCounts::add(long size, long long times)
+{
+    counts[size] += times;
+}
+
+void SizeCounts::merge(const SizeCounts &other)
+{
+    for (std::map<long, long long>::const_iterator it = other.counts.begin(); it != other.counts.end(); ++it) {
+        counts[it->first] += it->second;
+    }
+}
+
+long long SizeCounts::total() const
+{
+    long long sum = 0;
+    for (std::map<long, long long>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+        sum += it->second;
+    }
+    return sum;
+}
+
+PcStats::Key PcStats::key(int n, int s, float c)
+{
+    return std::make_tuple(n, s, long(lround(c * 10000.0)));
+}
+
+float PcStats::keyc(const Key &k)
+{
+    return std::get<2>(k) / 10000.0f;
+}
+
+void PcStats::add(int n, int s, float c, double pc, double phi)
+{
+    Entry &e = entry(n, s, c);
+    e.pc.add(pc);
+    e.phi.add(phi);
+    e.pchist.add(pc);
+    e.phihist.add(phi);
+}
+
+PcStats::Entry &PcStats::entry(int n, int s, float c)
+{
+    return table[key(n, s, c)];
+}
+
+void PcStats::merge(const PcStats &other)
+{
+    for (std::map<Key, Entry>::const_iterator it = other.table.begin(); it != other.table.end(); ++it) {
+        Entry &e = table[it->first];
+        e.pc.merge(it->second.pc);
+        e.phi.merge(it->second.phi);
+        e.pchist.merge(it->second.pchist);
+        e.phihist.merge(it->second.phihist);
+        e.clustersites.merge(it->second.clustersites);
+        e.clusterbonds.merge(it->second.clusterbonds);
+    }
+}
+
+void PcStats::clear()
+{
+    table.clear();
+}
+
+static void writemoments(std::ostream &out, const char *name, const Moments &m)
+{
+    out << name << " " << m.count << " " << m.mean << " " << m.m2 << " " << m.m3 << " " << m.m4 << " "
+        << m.min << " " << m.max << "\n";
+}
+
+static void writehistogram(std::ostream &out, const char *name, const Histogram &h)
+{
+    int nonzero = 0;
+    for (int b = 0; b < h.bins.size(); b++) {
+        if (h.bins[b] != 0) { nonzero++; }
+    }
+    out << name << " " << h.bins.size() << " " << h.lo << " " << h.hi << " " << nonzero;
+    for (int b = 0; b < h.bins.size(); b++) {
+        if (h.bins[b] != 0) { out << " " << b << ":" << h.bins[b]; }
+    }
+    out << "\n";
+}
+
+static void writesizecounts(std::ostream &out, const char *name, const SizeCounts &c)
+{
+    out << name << " " << c.counts.size();
+    for (std::map<long, long long>::const_iterator it = c.counts.begin(); it != c.counts.end(); ++it) {
+        out << " " << it->first << ":" << it->second;
+    }
+    out << "\n";
+}
+
+static bool readmoments(std::istream &in, const char *name, Moments &m)
+{
+    std::string tag;
+    in >> tag >> m.count >> m.mean >> m.m2 >> m.m3 >> m.m4 >> m.min >> m.max;
+    return bool(in) && tag == name;
+}
+
+static bool readhistogram(std::istream &in, const char *name, Histogram &h)
+{
+    std::string tag;
+    int numbins;
+    int nonzero;
+    in >> tag >> numbins >> h.lo >> h.hi >> nonzero;
+    if (!in || tag != name || numbins <= 0) { return false; }
+    h.bins.assign(numbins, 0);
+    for (int k = 0; k < nonzero; k++) {
+        int b;
+        char colon;
+        long long count;
+        in >> b >> colon >> count;
+        if (!in || colon != ':' || b < 0 || b >= numbins) { return false; }
+        h.bins[b] = count;
+    }
+    return true;
+}
+
+static bool readsizecounts(std::istream &in, SizeCounts &c)
+{
+    int nonzero;
+    in >> nonzero;
+    if (!in || nonzero < 0) { return false; }
+    for (int k = 0; k < nonzero; k++) {
+        long size;
+        char colon;
+        long long count;
+        in >> size >> colon >> count;
+        if (!in || colon != ':') { return false; }
+        c.counts[size] += count;
+    }
+    return true;
+}
+
+// Summary layout, per (n, s, c):
+//   entry n s c
+//   pc  count mean m2 m3 m4 min max      (and the same for phi)
+//   pchist numbins lo hi nonzero bin:count ...   (and the same for phi)
+//   clustersites nonzero size:count ...         (and the same for clusterbonds, only written when nonempty)
+//   derived pc_mean pc_stderr pc_var pc_skew pc_kurt phi_mean phi_stderr   (for reading by eye, ignored on read)
+void PcStats::write(std::ostream &out) const
+{
+    out << "# pc summary v2: running sums of pc and phi per (n, s, c), their nonempty histogram bins, and the rigid cluster sizes at pc\n";
+    out << std::setprecision(17);
+    for (std::map<Key, Entry>::const_iterator it = table.begin(); it != table.end(); ++it) {
+        const Entry &e = it->second;
+        out << "entry " << std::get<0>(it->first) << " " << std::get<1>(it->first) << " " << std::get<2>(it->first) << "\n";
+        writemoments(out, "pc", e.pc);
+        writemoments(out, "phi", e.phi);
+        writehistogram(out, "pchist", e.pchist);
+        writehistogram(out, "phihist", e.phihist);
+        if (!e.clustersites.counts.empty()) {
+            writesizecounts(out, "clustersites", e.clustersites);
+            writesizecounts(out, "clusterbonds", e.clusterbonds);
+        }
+        out << "derived " << e.pc.mean << " " << e.pc.stderror() << " " << e.pc.variance() << " " << e.pc.skewness()
+            << " " << e.pc.kurtosis() << " " << e.phi.mean << " " << e.phi.stderror() << "\n";
+    }
+}
+
+bool PcStats::read(std::istream &in)
+{
+    PcStats other;
+    std::string tag;
+    while (in >> tag) {
+        if (tag[0] == '#') {
+            std::getline(in, tag);
+            continue;
+        }
+        if (tag != "entry") { return false; }
+
+        int n;
+        int s;
+        long cc;
+        in >> n >> s >> cc;
+        Entry &e = other.table[std::make_tuple(n, s, cc)];
+        if (!readmoments(in, "pc", e.pc) || !readmoments(in, "phi", e.phi) ||
+            !readhistogram(in, "pchist", e.pchist) || !readhistogram(in, "phihist", e.phihist)) {
+            return false;
+        }
+        in >> tag;
+        while (tag == "clustersites" || tag == "clusterbonds") {    // not in v1 summaries
+            if (!readsizecounts(in, tag == "clustersites" ? e.clustersites : e.clusterbonds)) {
+                return false;
+            }
+            in >> tag;
+        }
+        if (tag != "derived") { return false; }
+        std::getline(in, tag);      // skip the derived quantities
+    }
+    merge(other);
+    return true;
+}
+
+bool PcStats::writefile(const std::string &filename) const
+{
+    // write to the side and rename, so that an interrupted run never leaves a half written summary
+    std::string tmpname = filename + ".tmp";
+    std::ofstream out(tmpname);
+    if (!out) { return false; }
+    write(out);
+    out.close();
+    if (!out) { return false; }
+    return rename(tmpname.c_str(), filename.c_str()) == 0;
+}
+
+bool PcStats::readfile(const std::string &filename)
+{
+    std::ifstream in(filename);
+    if (!in) { return false; }
+    return read(in);
+}
+
+bool PcStats::mergeintofile(const std::string &filename) const
+{
+    PcStats combined;
+    std::ifstream in(filename);
+    if (in && !combined.read(in)) {
+        std::cout << "I couldn't parse the summary in " << filename << ", so I'm not overwriting it.\n";
+        return false;
+    }
+    in.close();
+    combined.merge(*this);
+    return combined.writefile(filename);
+}
@@ -0,0 +1,92 @@
+//
+// Online aggregation of the critical packing and volume fractions found in each trial
+//
+
+#ifndef PEBBLEGAMETEST_PC_STATS_H
+#define PEBBLEGAMETEST_PC_STATS_H
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <iostream>
+
+// Moments keeps a running count, mean, and central moments (up to fourth order) of a sample
+// using Welford style single pass updates, so nothing but the running sums has to be stored
+class Moments {
+public:
+    long long count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;        // sum of squared deviations from the mean
+    double m3 = 0.0;        // sum of cubed deviations from the mean
+    double m4 = 0.0;        // sum of fourth power deviations from the mean
+    double min = 0.0;
+    double max = 0.0;
+
+    void add(double x);                    // include one more value in the sample
+    void merge(const Moments &other);      // combine with the moments of a disjoint sample (e.g. another worker)
+    double variance() const;               // unbiased sample variance
+    double stderror() const;               // standard error of the mean
+    double skewness() const;
+    double kurtosis() const;               // excess kurtosis
+};
+
+// Histogram counts values in equal width bins on [lo, hi), values outside are clamped into the end bins
+class Histogram {
+public:
+    double lo = 0.0;
+    double hi = 1.0;
+    std::vector<long long> bins;
+
+    Histogram(int numbins = 1000, double lo_input = 0.0, double hi_input = 1.0);
+    void add(double x);
+    void merge(const Histogram &other);
+};
+
+// SizeCounts counts how often each integer size turns up, keeping only the sizes that do, for distributions
+// like that of the rigid cluster sizes, whose range isn't known in advance
+class SizeCounts {
+public:
+    std::map<long, long long> counts;
+
+    void add(long size, long long times = 1);
+    void merge(const SizeCounts &other);
+    long long total() const;
+};
+
+// PcStats holds the moments and histograms of pc and phi for every (n, s, c) seen by a runner.
+// Summaries from parallel workers (threads or separate processes) are combined with merge() or by
+// reading their summary files back in, so a sweep never has to reparse the per-trial text output
+class PcStats {
+public:
+    struct Entry {
+        Moments pc;
+        Moments phi;
+        Histogram pchist;
+        Histogram phihist;
+        SizeCounts clustersites;    // sites of every rigid cluster but the spanning one at pc, over all trials
+        SizeCounts clusterbonds;    // and their independent bonds
+    };
+
+    // c is stored in units of 1e-4 so that the float correlation of a sweep gives a stable key
+    typedef std::tuple<int, int, long> Key;
+    std::map<Key, Entry> table;
+
+    static Key key(int n, int s, float c);
+    static float keyc(const Key &k);
+
+    void add(int n, int s, float c, double pc, double phi);
+    Entry &entry(int n, int s, float c);
+    void merge(const PcStats &other);
+    void clear();
+
+    // the summary is a compact text file, one block per (n, s, c), with the raw running sums written at
+    // full precision so that summaries merge without loss, and only the nonempty histogram bins listed
+    void write(std::ostream &out) const;
+    bool read(std::istream &in);
+    bool writefile(const std::string &filename) const;
+    bool readfile(const std::string &filename);    // merges the file into this table
+    bool mergeintofile(const std::string &filename) const;  // merges this table into whatever the file holds
+};
+
+#endif //PEBBLEGAMETEST_PC_STATS_H
@@ -0,0 +1,233 @@
+//
+// A standalone 2D pebble game on a growable graph, for small graphs built on the side of a SiteRP
+//
+
+#include "pebble_game.h"
+
+int PebbleGame::addvertex()
+{
+    pebbles.push_back(2);
+    out.push_back(std::vector<int>());
+    visited.push_back(0);
+    parent.push_back(-1);
+    return int(pebbles.size()) - 1;
+}
+
+void PebbleGame::clear()
+{
+    pebbles.clear();
+    out.clear();
+    visited.clear();
+    parent.clear();
+    bonds.clear();
+    journal.clear();
+    journaling = false;
+}
+
+bool PebbleGame::operator==(const PebbleGame &other) const
+{
+    return pebbles == other.pebbles && out == other.out && bonds == other.bonds;
+}
+
+void PebbleGame::startjournal()
+{
+    journal.clear();
+    journaling = true;
+}
+
+// Each change is undone with the game in the state it left it, so a reversed bond is the last one out of to, and
+// an added bond the last one out of from and the last in bonds
+void PebbleGame::rollback()
+{
+    for (int k = int(journal.size()) - 1; k >= 0; k--) {
+        const Change &c = journal[k];
+        if (c.at == MOVEDPEBBLE) {
+            pebbles[c.to]--;
+            pebbles[c.from]++;
+        }
+        else if (c.at == ADDEDBOND) {
+            out[c.from].pop_back();
+            bonds.pop_back();
+            pebbles[c.from]++;
+        }
+        else {
+            out[c.to].pop_back();
+            out[c.from].insert(out[c.from].begin() + c.at, c.to);
+        }
+    }
+    journal.clear();
+    journaling = false;
+}
+
+// findpebble does a breadth first search along the directed bonds from i for a free pebble that isn't on i or
+// keep, and if it finds one moves it onto i by reversing the bonds on the way. Paths may pass through keep,
+// they just never take its pebbles
+bool PebbleGame::findpebble(int i, int keep)
+{
+    stamp++;
+    queue.assign(1, i);
+    visited[i] = stamp;
+    parent[i] = -1;
+    for (int head = 0; head < queue.size(); head++) {
+        int cl = queue[head];
+        for (int k = 0; k < out[cl].size(); k++) {
+            int prosp = out[cl][k];
+            if (visited[prosp] == stamp) {
+                continue;
+            }
+            visited[prosp] = stamp;
+            parent[prosp] = cl;
+            if (prosp != keep && pebbles[prosp] > 0) {
+                // reverse the path back to i, which carries one pebble from prosp to i
+                pebbles[prosp]--;
+                pebbles[i]++;
+                if (journaling) {
+                    journal.push_back(Change{prosp, i, MOVEDPEBBLE});
+                }
+                for (int to = prosp; parent[to] != -1; to = parent[to]) {
+                    int from = parent[to];
+                    for (int m = 0; m < out[from].size(); m++) {
+                        if (out[from][m] == to) {
+                            out[from].erase(out[from].begin() + m);
+                            if (journaling) {
+                                journal.push_back(Change{from, to, m});
+                            }
+                            break;
+                        }
+                    }
+                    out[to].push_back(from);
+                }
+                return true;
+            }
+            queue.push_back(prosp);
+        }
+    }
+    return false;
+}
+
+// gather tries to bring want_i pebbles onto i and want_j onto j, alternating until neither can gain any more
+bool PebbleGame::gather(int i, int j, int want_i, int want_j)
+{
+    bool progress = true;
+    while (progress && (pebbles[i] < want_i || pebbles[j] < want_j)) {
+        progress = false;
+        while (pebbles[i] < want_i && findpebble(i, j)) {
+            progress = true;
+        }
+        while (pebbles[j] < want_j && findpebble(j, i)) {
+            progress = true;
+        }
+    }
+    return pebbles[i] >= want_i && pebbles[j] >= want_j;
+}
+
+bool PebbleGame::isindependent(int i, int j)
+{
+    return i != j && gather(i, j, 2, 2);
+}
+
+bool PebbleGame::isrigid(int i, int j)
+{
+    return !isindependent(i, j);
+}
+
+bool PebbleGame::addbond(int i, int j)
+{
+    if (!isindependent(i, j)) {
+        return false;
+    }
+    pebbles[i]--;
+    out[i].push_back(j);
+    bonds.push_back(std::make_pair(i, j));
+    if (journaling) {
+        journal.push_back(Change{i, j, ADDEDBOND});
+    }
+    return true;
+}
+
+// reachesfree looks for a pebble reachable from w, not counting the ones pinned on pin1 and pin2
+bool PebbleGame::reachesfree(int w, int pin1, int pin2)
+{
+    stamp++;
+    queue.assign(1, w);
+    visited[w] = stamp;
+    for (int head = 0; head < queue.size(); head++) {
+        int cl = queue[head];
+        if (cl != pin1 && cl != pin2 && pebbles[cl] > 0) {
+            return true;
+        }
+        for (int k = 0; k < out[cl].size(); k++) {
+            int prosp = out[cl][k];
+            if (visited[prosp] != stamp) {
+                visited[prosp] = stamp;
+                queue.push_back(prosp);
+            }
+        }
+    }
+    return false;
+}
+
+bool PebbleGame::rigidwith(int u, int v, int w)
+{
+    gather(u, v, 2, 1);
+    return w == u || w == v || !reachesfree(w, u, v);
+}
+
+// The pebble covering the bond goes back to whichever end the bond now leaves. Bonds that were rejected as
+// redundant while it was in the graph stay out, so only the bonds added after it should be taken out first
+void PebbleGame::removebond(int i, int j)
+{
+    for (int b = int(bonds.size()) - 1; b >= 0; b--) {
+        if ((bonds[b].first == i && bonds[b].second == j) || (bonds[b].first == j && bonds[b].second == i)) {
+            bonds.erase(bonds.begin() + b);
+            break;
+        }
+    }
+    for (int m = 0; m < out[i].size(); m++) {
+        if (out[i][m] == j) {
+            out[i].erase(out[i].begin() + m);
+            pebbles[i]++;
+            return;
+        }
+    }
+    for (int m = 0; m < out[j].size(); m++) {
+        if (out[j][m] == i) {
+            out[j].erase(out[j].begin() + m);
+            pebbles[j]++;
+            return;
+        }
+    }
+}
+
+// For each bond not yet in a cluster, three pebbles are pinned on its ends, and every vertex that can't be
+// given a pebble from elsewhere is rigid with the bond (Jacobs and Hendrickson). The bonds with both ends in
+// the cluster belong to it, since two rigid clusters share at most one vertex
+int PebbleGame::rigidclusters(std::vector<int> &bondcluster, std::vector<std::vector<char> > &member)
+{
+    bondcluster.assign(bonds.size(), -1);
+    member.clear();
+    for (int b = 0; b < bonds.size(); b++) {
+        if (bondcluster[b] != -1) {
+            continue;
+        }
+        int u = bonds[b].first;
+        int v = bonds[b].second;
+        gather(u, v, 2, 1);
+
+        std::vector<char> inside(pebbles.size(), 0);
+        inside[u] = 1;
+        inside[v] = 1;
+        for (int w = 0; w < pebbles.size(); w++) {
+            if (w != u && w != v && !reachesfree(w, u, v)) {
+                inside[w] = 1;
+            }
+        }
+        for (int other = b; other < bonds.size(); other++) {
+            if (bondcluster[other] == -1 && inside[bonds[other].first] && inside[bonds[other].second]) {
+                bondcluster[other] = int(member.size());
+            }
+        }
+        member.push_back(inside);
+    }
+    return int(member.size());
+}
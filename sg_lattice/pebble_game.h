@@ -0,0 +1,61 @@
+//
+// A standalone 2D pebble game on a growable graph, for small graphs built on the side of a SiteRP
+//
+
+#ifndef PEBBLEGAMETEST_PEBBLE_GAME_H
+#define PEBBLEGAMETEST_PEBBLE_GAME_H
+
+#include <vector>
+
+// PebbleGame plays the (2,3) pebble game of Jacobs and Hendrickson: every vertex starts with two pebbles, an
+// independent bond is directed away from the vertex whose pebble covers it, and a bond is independent exactly
+// when four pebbles can be gathered on its ends. Unlike SiteRP it doesn't know anything about the lattice,
+// vertices are added as they are needed, so it can be used for gadget graphs and other small auxiliary graphs
+class PebbleGame {
+public:
+    int addvertex();                        // adds a vertex with two pebbles and returns its index
+    bool addbond(int i, int j);             // adds the bond if it is independent, returns whether it was
+    bool isindependent(int i, int j);       // would the bond i j be independent? (moves pebbles, but adds nothing)
+    bool isrigid(int i, int j);             // are i and j mutually rigid, i.e. is the bond i j implied by the graph
+    bool rigidwith(int u, int v, int w);    // is w rigid with the bond u v, which has to be in the graph
+    void removebond(int i, int j);          // takes an independent bond out again, giving its pebble back
+    void startjournal();                    // from here on the bonds added and the pebbles moved are journaled
+    void rollback();                        // undoes all of them, in reverse, and stops journaling
+    int numvertices() const { return int(pebbles.size()); }
+    int rank() const { return int(bonds.size()); }
+    void clear();
+    // the same bonds, directed the same way in the same order, and the same pebbles on every vertex
+    bool operator==(const PebbleGame &other) const;
+
+    // rigidclusters labels every independent bond with the index of its rigid cluster and returns the number of
+    // clusters, with member[k][v] set when vertex v belongs to cluster k
+    int rigidclusters(std::vector<int> &bondcluster, std::vector<std::vector<char> > &member);
+
+    std::vector<std::pair<int, int> > bonds;    // the independent bonds in the order they were added
+
+private:
+    bool findpebble(int i, int keep);      // moves a free pebble onto i along a directed path, leaving keep's alone
+    bool gather(int i, int j, int want_i, int want_j);
+    bool reachesfree(int w, int pin1, int pin2);    // can a pebble other than those pinned on pin1, pin2 reach w
+
+    std::vector<int> pebbles;               // free pebbles on each vertex
+    std::vector<std::vector<int> > out;     // the directed bonds leaving each vertex
+    std::vector<int> visited;               // visit stamps for the searches
+    std::vector<int> parent;
+    std::vector<int> queue;                 // the breadth first searches' queue, kept to save allocating one each time
+    int stamp = 0;
+
+    // a change to the game: the bond from to reversed after being taken out of out[from] at at, or with at
+    // MOVEDPEBBLE a pebble moved from from to to, or with at ADDEDBOND the bond from to added
+    struct Change {
+        int from;
+        int to;
+        int at;
+    };
+    static const int MOVEDPEBBLE = -1;
+    static const int ADDEDBOND = -2;
+    std::vector<Change> journal;
+    bool journaling = false;
+};
+
+#endif //PEBBLEGAMETEST_PEBBLE_GAME_H
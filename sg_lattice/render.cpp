@@ -0,0 +1,257 @@
+//
+// Pictures of a configuration of the lattice drawn straight from the engine, as PPM images or SVG
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "render.h"
+
+static const uint8_t KINDCOLOR[NUM_RENDER_KINDS][3] = {{205, 205, 205}, {40, 90, 200}, {210, 40, 40}, {20, 150, 60}};
+static const char *KINDHEX[NUM_RENDER_KINDS] = {"#cdcdcd", "#285ac8", "#d22828", "#14963c"};
+static const uint8_t SITECOLOR[2][3] = {{0, 0, 0}, {0, 90, 30}};    // occupied, and in the giant cluster too
+static const char *SITEHEX[2] = {"#000000", "#005a1e"};
+static const int SVGCELL = 16;          // the side of a cell of the coarse SVG, in SVG units
+
+// where the picture puts the lattice: pixel = (x - minx) * scale + pad across, and (maxy - y) * scale + pad down
+struct Frame {
+    double minx;
+    double maxy;
+    double scale;
+    double pad;
+    int width;
+    int height;
+
+    double px(double x) const { return (x - minx) * scale + pad; }
+    double py(double y) const { return (maxy - y) * scale + pad; }
+};
+
+static Frame frame(const RenderScene &scene, int width)
+{
+    double minx = scene.x[0], maxx = scene.x[0], miny = scene.y[0], maxy = scene.y[0];
+    for (int i = 1; i < scene.size; i++) {
+        minx = std::min(minx, double(scene.x[i]));
+        maxx = std::max(maxx, double(scene.x[i]));
+        miny = std::min(miny, double(scene.y[i]));
+        maxy = std::max(maxy, double(scene.y[i]));
+    }
+    Frame f;
+    f.width = std::max(width, 16);
+    f.pad = 0.02 * f.width;
+    f.scale = (f.width - 2 * f.pad) / std::max(maxx - minx, 1.0);
+    f.minx = minx;
+    f.maxy = maxy;
+    f.height = int(std::ceil((maxy - miny) * f.scale + 2 * f.pad));
+    return f;
+}
+
+static bool wraps(const RenderScene &scene, const RenderBond &b)
+{
+    return std::fabs(scene.x[b.first] - scene.x[b.second]) > 2 || std::fabs(scene.y[b.first] - scene.y[b.second]) > 2;
+}
+
+// a piece of a bond to draw, from (x0, y0) to (x1, y1) in lattice units
+struct Segment {
+    double x0, y0, x1, y1;
+};
+
+// The segments a bond is drawn as: the bond itself, or for one that wraps the two halves running out of its ends
+// towards the nearest copies of the other end. A wrapping bond no combination of periods brings back to a bond
+// length gives no segments
+static std::vector<Segment> segments(const RenderScene &scene, const RenderBond &b)
+{
+    std::vector<Segment> found;
+    double px = scene.x[b.first], py = scene.y[b.first];
+    double qx = scene.x[b.second], qy = scene.y[b.second];
+    if (!wraps(scene, b)) {
+        found.push_back(Segment{px, py, qx, qy});
+        return found;
+    }
+    int numperiods = int(scene.periods.size());
+    for (int a = -1; a <= 1; a++) {
+        for (int c = -1; c <= 1; c++) {
+            double dx = qx - px, dy = qy - py;
+            if (numperiods > 0) {
+                dx += a * scene.periods[0].first;
+                dy += a * scene.periods[0].second;
+            }
+            if (numperiods > 1) {
+                dx += c * scene.periods[1].first;
+                dy += c * scene.periods[1].second;
+            }
+            if (dx * dx + dy * dy < 2) {
+                found.push_back(Segment{px, py, px + dx / 2, py + dy / 2});
+                found.push_back(Segment{qx, qy, qx - dx / 2, qy - dy / 2});
+                return found;
+            }
+        }
+    }
+    return found;
+}
+
+static void plot(std::vector<uint8_t> &pixels, const Frame &f, int u, int v, const uint8_t *color)
+{
+    if (u < 0 || v < 0 || u >= f.width || v >= f.height) {
+        return;
+    }
+    std::copy(color, color + 3, pixels.begin() + 3 * (size_t(v) * f.width + u));
+}
+
+// Bresenham's line, thick lines being drawn again a pixel to either side
+static void line(std::vector<uint8_t> &pixels, const Frame &f, int u0, int v0, int u1, int v1, const uint8_t *color)
+{
+    int du = std::abs(u1 - u0), dv = -std::abs(v1 - v0);
+    int su = u0 < u1 ? 1 : -1, sv = v0 < v1 ? 1 : -1;
+    int error = du + dv;
+    while (true) {
+        plot(pixels, f, u0, v0, color);
+        if (u0 == u1 && v0 == v1) {
+            break;
+        }
+        int twice = 2 * error;
+        if (twice >= dv) {
+            error += dv;
+            u0 += su;
+        }
+        if (twice <= du) {
+            error += du;
+            v0 += sv;
+        }
+    }
+}
+
+static bool renderppm(const RenderScene &scene, const std::string &filename, const Frame &f)
+{
+    bool coarse = f.scale < 2;
+    std::vector<uint8_t> pixels(size_t(f.width) * f.height * 3, 255);
+    int thick = f.scale >= 6 ? 1 : 0;
+    for (int kind = coarse ? RENDER_INDEPENDENT : RENDER_LATTICE; kind < NUM_RENDER_KINDS; kind++) {
+        for (size_t k = 0; k < scene.bonds.size(); k++) {
+            const RenderBond &b = scene.bonds[k];
+            if (b.kind != kind) {
+                continue;
+            }
+            std::vector<Segment> parts = segments(scene, b);
+            for (int m = 0; m < parts.size(); m++) {
+                int u0 = int(f.px(parts[m].x0)), v0 = int(f.py(parts[m].y0));
+                int u1 = int(f.px(parts[m].x1)), v1 = int(f.py(parts[m].y1));
+                for (int offset = -thick; offset <= thick; offset++) {
+                    if (kind == RENDER_GIANT || offset == 0) {
+                        line(pixels, f, u0 + offset, v0, u1 + offset, v1, KINDCOLOR[kind]);
+                    }
+                }
+            }
+        }
+    }
+    int radius = int(f.scale * 0.15);
+    for (int i = 0; i < scene.size; i++) {
+        if (scene.occ[i] == 0) {
+            continue;
+        }
+        int u = int(f.px(scene.x[i])), v = int(f.py(scene.y[i]));
+        const uint8_t *color = SITECOLOR[!scene.giant.empty() && scene.giant[i] != 0];
+        for (int dv = -radius; dv <= radius; dv++) {
+            for (int du = -radius; du <= radius; du++) {
+                plot(pixels, f, u + du, v + dv, color);
+            }
+        }
+    }
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out << "P6\n" << f.width << " " << f.height << "\n255\n";
+    out.write((const char *) pixels.data(), pixels.size());
+    out.close();
+    if (!out) {
+        std::cout << "I couldn't write the picture " << filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+static bool rendersvg(const RenderScene &scene, const std::string &filename, const Frame &f)
+{
+    std::ofstream out(filename, std::ios::trunc);
+    out << std::fixed << std::setprecision(2);
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << f.width << "\" height=\"" << f.height
+        << "\" viewBox=\"0 0 " << f.width << " " << f.height << "\">\n";
+    out << "<rect width=\"100%\" height=\"100%\" fill=\"#ffffff\"/>\n";
+
+    if (f.scale < 2) {
+        // a cell is shaded from white to grey by the fraction of its sites that are occupied, and towards green by
+        // the fraction in the giant cluster
+        int across = (f.width + SVGCELL - 1) / SVGCELL;
+        int down = (f.height + SVGCELL - 1) / SVGCELL;
+        std::vector<int> sites(size_t(across) * down, 0), occupied(sites.size(), 0), giant(sites.size(), 0);
+        for (int i = 0; i < scene.size; i++) {
+            int cell = int(f.py(scene.y[i])) / SVGCELL * across + int(f.px(scene.x[i])) / SVGCELL;
+            sites[cell]++;
+            occupied[cell] += scene.occ[i] != 0;
+            giant[cell] += !scene.giant.empty() && scene.giant[i] != 0;
+        }
+        for (int cell = 0; cell < sites.size(); cell++) {
+            if (sites[cell] == 0) {
+                continue;
+            }
+            double grey = 255 - 200.0 * occupied[cell] / sites[cell];
+            double green = double(giant[cell]) / sites[cell];
+            int color[3];
+            for (int c = 0; c < 3; c++) {
+                color[c] = int((1 - green) * grey + green * KINDCOLOR[RENDER_GIANT][c]);
+            }
+            char hex[8];
+            snprintf(hex, sizeof(hex), "#%02x%02x%02x", color[0], color[1], color[2]);
+            out << "<rect x=\"" << cell % across * SVGCELL << "\" y=\"" << cell / across * SVGCELL << "\" width=\""
+                << SVGCELL << "\" height=\"" << SVGCELL << "\" fill=\"" << hex << "\"/>\n";
+        }
+    }
+    else {
+        for (int kind = RENDER_LATTICE; kind < NUM_RENDER_KINDS; kind++) {
+            double stroke = f.scale * (kind == RENDER_GIANT ? 0.12 : kind == RENDER_LATTICE ? 0.03 : 0.06);
+            out << "<g stroke=\"" << KINDHEX[kind] << "\" stroke-width=\"" << stroke << "\">\n";
+            for (size_t k = 0; k < scene.bonds.size(); k++) {
+                const RenderBond &b = scene.bonds[k];
+                if (b.kind != kind) {
+                    continue;
+                }
+                std::vector<Segment> parts = segments(scene, b);
+                for (int m = 0; m < parts.size(); m++) {
+                    out << "<line x1=\"" << f.px(parts[m].x0) << "\" y1=\"" << f.py(parts[m].y0) << "\" x2=\""
+                        << f.px(parts[m].x1) << "\" y2=\"" << f.py(parts[m].y1) << "\"/>\n";
+                }
+            }
+            out << "</g>\n";
+        }
+        for (int ingiant = 0; ingiant < 2; ingiant++) {
+            out << "<g fill=\"" << SITEHEX[ingiant] << "\">\n";
+            for (int i = 0; i < scene.size; i++) {
+                bool giant = !scene.giant.empty() && scene.giant[i] != 0;
+                if (scene.occ[i] != 0 && giant == ingiant) {
+                    out << "<circle cx=\"" << f.px(scene.x[i]) << "\" cy=\"" << f.py(scene.y[i]) << "\" r=\""
+                        << f.scale * 0.15 << "\"/>\n";
+                }
+            }
+            out << "</g>\n";
+        }
+    }
+    out << "</svg>\n";
+    out.close();
+    if (!out) {
+        std::cout << "I couldn't write the picture " << filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool render(const RenderScene &scene, const std::string &filename, int width)
+{
+    if (scene.size == 0 || scene.x == nullptr || scene.y == nullptr || scene.occ == nullptr) {
+        std::cout << "There is no lattice to draw in " << filename << ".\n";
+        return false;
+    }
+    Frame f = frame(scene, width);
+    bool svg = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".svg") == 0;
+    return svg ? rendersvg(scene, filename, f) : renderppm(scene, filename, f);
+}
@@ -0,0 +1,49 @@
+//
+// Pictures of a configuration of the lattice drawn straight from the engine, as PPM images or SVG
+//
+
+#ifndef PEBBLEGAMETEST_RENDER_H
+#define PEBBLEGAMETEST_RENDER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vertex_index.h"
+
+// what a bond is drawn as, later kinds on top of earlier ones
+enum RenderKind {
+    RENDER_LATTICE = 0,         // a pair of sites that may share a bond, light grey
+    RENDER_INDEPENDENT,         // an independent bond, blue
+    RENDER_REDUNDANT,           // a redundant bond, red
+    RENDER_GIANT,               // a bond of the giant rigid cluster, green
+    NUM_RENDER_KINDS
+};
+
+struct RenderBond {
+    vertex_t first;
+    vertex_t second;
+    int kind;
+};
+
+// A RenderScene is everything a picture shows, in whatever numbering the sites have: their positions (in units of
+// the bond length), which are occupied and which are in the giant rigid cluster, and the bonds. A bond longer than
+// two bond lengths wraps around a periodic lattice, and is drawn as two halves, one from each end out towards the
+// copy of the other end one of the periods (or the sum or difference of two) away. Without periods it is left out
+struct RenderScene {
+    int size = 0;
+    const float *x = nullptr;
+    const float *y = nullptr;
+    const sitestate_t *occ = nullptr;
+    std::vector<uint8_t> giant;         // 1 for the sites of the giant rigid cluster
+    std::vector<RenderBond> bonds;
+    std::vector<std::pair<float, float> > periods;     // the translations that take the lattice onto itself
+};
+
+// render writes the scene to filename, as SVG if it ends in .svg and as a binary PPM otherwise, width pixels (or
+// SVG units) across. Once a bond would be shorter than two pixels the picture is drawn at a lower level of detail:
+// the PPM leaves the lattice bonds out and draws sites a pixel each, and the SVG stops drawing bonds and sites one
+// by one and shades a grid of cells instead, by how much of each is occupied and how much is in the giant cluster,
+// so the file stays a few thousand shapes however large the lattice is
+bool render(const RenderScene &scene, const std::string &filename, int width);
+
+#endif //PEBBLEGAMETEST_RENDER_H
@@ -5,8 +5,11 @@
 #ifndef SG_H
 #define SG_H
 
-//Returns the total number of vertices in the latice
-int TotalVerts(int N, int S);
+#include <vector>
+#include "vertex_index.h"
+
+//Returns the total number of vertices in the latice, worked out exactly, -1 if vertex_t can't hold it
+vertex_t TotalVerts(int N, int S);
 
 //Returns the number of vertices along the bottom edge of the unit cell
 int EdgeVerts(int N, int S);
@@ -26,13 +29,17 @@ void SG_LatticeVertList(std::vector<int> &VERTICES, int S);
 //The element slots represent vertices, and contain the layer number at which that vertex can be found
 void FillLayers(std::vector<int> &VERTICES, std::vector<int> &LAYERS);
 
-//Determines what type of vertex dum is and records it in the vector type under dum's index
-void TypeAssign(std::vector <int> &TYPE, int DUM, int TEST_LAYER, int SINGLE_TRI_INDEX, int VERT_COUNT, int VERT_COUNT_BELOW, int LL, int S);
+//Determines what type of vertex (1 to 4) a vertex is from its place on its layer and triangle, and returns it
+int TypeAssign(int TEST_LAYER, int SINGLE_TRI_INDEX, int VERT_COUNT, int VERT_COUNT_BELOW, int LL, int S);
 
 //Returns how many vertices far right into a layer dum is
-int Depth(std::vector<int> &LAYERS, int DUM, int DUM_LAYER, int SIZE);
+int Depth(std::vector<int> &LAYERS, vertex_t DUM, int DUM_LAYER, vertex_t SIZE);
 
 //Defines important quantities and assigns neighbors
-int DoEverything(int DUM, int N, int S, int SIZE, int D);
+vertex_t DoEverything(vertex_t DUM, int N, int S, vertex_t SIZE, int D);
+
+//Fills NBS with the neighbors of DUM in directions 1 to 6 (-1 where there is none) from the filled VERTICES and LAYERS
+//lists of the lattice, without writing anything
+void SG_Neighbors(vertex_t DUM, int N, int S, vertex_t SIZE, std::vector<int> &VERTICES, std::vector<int> &LAYERS, vertex_t NBS[6]);
 
 #endif
@@ -5,8 +5,15 @@
 #ifndef sg_coordinates_h
 #define sg_coordinates_h
 
+#include <vector>
+
 //Generates a coordinate plot text file of a lattice of fractal iteration n and lattice
 //length s (in units of SG's). This is to be used as plotting input code in Mathematica.
-void sg_coords(int N, int S);
+//The sites are in the order the engine numbers them (layer by layer), one position each. With BINARY they go to
+//coords_n{N}s{S}.bin instead, as x, y float pairs
+void sg_coords(int N, int S, bool BINARY = false);
+
+//Fills X and Y with the position of every site, in units of the bond length, in the same order
+void sg_positions(int N, int S, std::vector<float> &X, std::vector<float> &Y);
 
 #endif /* sg_coordinates_h */
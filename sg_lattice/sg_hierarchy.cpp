@@ -0,0 +1,438 @@
+//
+// Rigidity of a site diluted SG lattice solved gasket by gasket instead of with one flat pebble game
+//
+
+#include <algorithm>
+#include <iostream>
+#include "sg_hierarchy.h"
+
+// a step in direction d changes the row and the column by these, with directions 3 and 6 keeping the column
+static const int drow[6] = {-1, 0, 1, 1, 0, -1};
+static const int dcol[6] = {1, 1, 0, -1, -1, 0};
+
+// the corners of the three children of a gasket, in the local numbering top 0, lower left 1, lower right 2,
+// middle of the left side 3, middle of the bottom 4, middle of the right side 5
+static const int local[3][3] = {{0, 3, 5}, {3, 1, 4}, {5, 4, 2}};
+
+bool SGHierarchy::build(int n_input, int s_input, const std::vector<int> &neighbors)
+{
+    built = false;
+    n = n_input;
+    s = s_input;
+    size = int(neighbors.size() / 6);
+    ll = s << n;
+    if (s < 2) {
+        std::cout << "The hierarchical solver needs a periodic lattice, but s is " << s << ".\n";
+        return false;
+    }
+
+    // place every site in the frame by a breadth first search from site 0, checking that the neighbors agree
+    std::vector<int> row(size, -1);
+    col.assign(size, -1);
+    row[0] = 0;
+    col[0] = 0;
+    std::vector<int> queue(1, 0);
+    for (int head = 0; head < queue.size(); head++) {
+        int cl = queue[head];
+        for (int d = 0; d < 6; d++) {
+            int prosp = neighbors[6 * cl + d];
+            if (prosp == -1) {
+                continue;
+            }
+            int r = (row[cl] + drow[d] + ll) % ll;
+            int c = (col[cl] + dcol[d] + ll) % ll;
+            if (row[prosp] == -1) {
+                row[prosp] = r;
+                col[prosp] = c;
+                queue.push_back(prosp);
+            }
+            else if (row[prosp] != r || col[prosp] != c) {
+                std::cout << "Site " << prosp << " doesn't sit where its neighbor " << cl << " says it should.\n";
+                return false;
+            }
+        }
+    }
+    std::vector<int> siteat(ll * ll, -1);
+    for (int site = 0; site < size; site++) {
+        if (row[site] == -1 || siteat[row[site] * ll + col[site]] != -1) {
+            std::cout << "Site " << site << " couldn't be given a place of its own in the lattice.\n";
+            return false;
+        }
+        siteat[row[site] * ll + col[site]] = site;
+    }
+
+    // the top level gaskets have their top corners on the coarse lattice, every 2^n rows and columns, and each
+    // gasket of side L is split into three of side L / 2
+    corners.assign(n + 1, std::vector<int>());
+    int side = 1 << n;
+    for (int i = 0; i < s; i++) {
+        for (int j = 0; j < s; j++) {
+            int r = i * side;
+            int c = j * side;
+            corners[n].push_back(siteat[r * ll + c]);
+            corners[n].push_back(siteat[((r + side) % ll) * ll + (c - side + ll) % ll]);
+            corners[n].push_back(siteat[((r + side) % ll) * ll + c]);
+        }
+    }
+    for (int level = n; level > 0; level--) {
+        int half = 1 << (level - 1);
+        for (int k = 0; k < corners[level].size(); k++) {
+            if (corners[level][k] == -1) {
+                std::cout << "A gasket corner at level " << level << " isn't a site of the lattice.\n";
+                return false;
+            }
+        }
+        for (int g = 0; g < corners[level].size() / 3; g++) {
+            int r = row[corners[level][3 * g]];
+            int c = col[corners[level][3 * g]];
+            int at[6];
+            at[0] = corners[level][3 * g];
+            at[1] = corners[level][3 * g + 1];
+            at[2] = corners[level][3 * g + 2];
+            at[3] = siteat[((r + half) % ll) * ll + (c - half + ll) % ll];
+            at[4] = siteat[((r + 2 * half) % ll) * ll + (c - half + ll) % ll];
+            at[5] = siteat[((r + half) % ll) * ll + c];
+            for (int i = 0; i < 3; i++) {
+                for (int k = 0; k < 3; k++) {
+                    corners[level - 1].push_back(at[local[i][k]]);
+                }
+            }
+        }
+    }
+
+    // the smallest triangles have to hold every bond of the lattice exactly once
+    int numbonds = 0;
+    for (int k = 0; k < neighbors.size(); k++) {
+        numbonds += neighbors[k] != -1;
+    }
+    bondsite.clear();
+    for (int g = 0; g < corners[0].size() / 3; g++) {
+        for (int k = 0; k < 3; k++) {
+            int u = corners[0][3 * g + k];
+            int v = corners[0][3 * g + (k + 1) % 3];
+            if (u == -1 || v == -1 || std::find(&neighbors[6 * u], &neighbors[6 * u] + 6, v) == &neighbors[6 * u] + 6) {
+                std::cout << "A smallest triangle of the gaskets isn't a triangle of the lattice.\n";
+                return false;
+            }
+            bondsite.push_back(u);
+            bondsite.push_back(v);
+        }
+    }
+    if (bondsite.size() != numbonds) {
+        std::cout << "The gaskets hold " << bondsite.size() / 2 << " bonds, but the lattice has " << numbonds / 2 << ".\n";
+        return false;
+    }
+
+    gadgets.assign(n + 1, std::vector<Gadget>());
+    for (int level = 0; level <= n; level++) {
+        gadgets[level].resize(corners[level].size() / 3);
+    }
+    built = true;
+    return true;
+}
+
+// addgadget puts the bars and stars of a gadget into a pebble game, on the vertices a, b, c
+void SGHierarchy::addgadget(PebbleGame &game, const Gadget &g, int a, int b, int c)
+{
+    int v[3] = {a, b, c};
+    int numbars = 0;
+    for (int k = 0; k < 3; k++) {
+        if (g.bar[k]) {
+            game.addbond(v[k], v[(k + 1) % 3]);
+            numbars++;
+        }
+    }
+    for (int star = numbars; star < g.rank; star++) {
+        int w = game.addvertex();
+        game.addbond(w, a);
+        game.addbond(w, b);
+        game.addbond(w, c);
+    }
+}
+
+// takeout removes the bonds added to the game since it had the given rank, last first, which leaves it with the
+// independent bonds it had then
+static void takeout(PebbleGame &game, int rank)
+{
+    while (game.rank() > rank) {
+        game.removebond(game.bonds.back().first, game.bonds.back().second);
+    }
+}
+
+// contract reads off the gadget that the graph in the pebble game puts on a, b, c: a corner pair is held rigid
+// if its bar would be redundant, and the rank is three less the number of triangle bars that would still be
+// independent. The bars it tries are taken out again
+SGHierarchy::Gadget SGHierarchy::contract(PebbleGame &game, int a, int b, int c)
+{
+    int v[3] = {a, b, c};
+    Gadget g;
+    for (int k = 0; k < 3; k++) {
+        g.bar[k] = game.isrigid(v[k], v[(k + 1) % 3]);
+    }
+    int before = game.rank();
+    g.rank = 3;
+    for (int k = 0; k < 3; k++) {
+        if (game.addbond(v[k], v[(k + 1) % 3])) {
+            g.rank--;
+        }
+    }
+    takeout(game, before);
+    return g;
+}
+
+// complement gives each top gasket from first to last the gadget of all the other top gaskets, with the game
+// holding the gadgets of those outside the range. Each half of the range is added in turn while the other half
+// is worked out, and taken out again afterwards, so a gadget is played about log2(s * s) times rather than once
+// for every other top gasket. The extra vertices of stars taken out stay behind, unattached with their two pebbles
+void SGHierarchy::complement(PebbleGame &game, const std::vector<int> &topid, int first, int last,
+                             std::vector<Gadget> &outside)
+{
+    if (last - first == 1) {
+        outside[first] = contract(game, topid[corners[n][3 * first]], topid[corners[n][3 * first + 1]],
+                                  topid[corners[n][3 * first + 2]]);
+        return;
+    }
+    int middle = (first + last) / 2;
+    int range[2][2] = {{first, middle}, {middle, last}};
+    for (int half = 0; half < 2; half++) {
+        int before = game.rank();
+        const int *other = range[1 - half];
+        for (int g = other[0]; g < other[1]; g++) {
+            addgadget(game, gadgets[n][g], topid[corners[n][3 * g]], topid[corners[n][3 * g + 1]],
+                      topid[corners[n][3 * g + 2]]);
+        }
+        complement(game, topid, range[half][0], range[half][1], outside);
+        takeout(game, before);
+    }
+}
+
+bool SGHierarchy::solve(const sitestate_t *occ)
+{
+    if (!built) {
+        return false;
+    }
+
+    // bottom-up: the smallest triangles hold a bar for every pair of occupied corners, bigger gaskets are
+    // contracted from the gadgets of their children
+    for (int g = 0; g < gadgets[0].size(); g++) {
+        Gadget &leaf = gadgets[0][g];
+        leaf.rank = 0;
+        for (int k = 0; k < 3; k++) {
+            leaf.bar[k] = occ[corners[0][3 * g + k]] == 1 && occ[corners[0][3 * g + (k + 1) % 3]] == 1;
+            leaf.rank += leaf.bar[k];
+        }
+    }
+    for (int level = 1; level <= n; level++) {
+        for (int g = 0; g < gadgets[level].size(); g++) {
+            PebbleGame game;
+            for (int k = 0; k < 6; k++) {
+                game.addvertex();
+            }
+            for (int i = 0; i < 3; i++) {
+                addgadget(game, gadgets[level - 1][3 * g + i], local[i][0], local[i][1], local[i][2]);
+            }
+            gadgets[level][g] = contract(game, 0, 1, 2);
+        }
+    }
+
+    // the top level: one pebble game on the corners of the top gaskets and their gadgets
+    int numtop = int(gadgets[n].size());
+    std::vector<int> topid(size, -1);
+    int numcorners = 0;
+    for (int k = 0; k < corners[n].size(); k++) {
+        if (topid[corners[n][k]] == -1) {
+            topid[corners[n][k]] = numcorners++;
+        }
+    }
+    PebbleGame top;
+    for (int k = 0; k < numcorners; k++) {
+        top.addvertex();
+    }
+    for (int g = 0; g < numtop; g++) {
+        addgadget(top, gadgets[n][g], topid[corners[n][3 * g]], topid[corners[n][3 * g + 1]], topid[corners[n][3 * g + 2]]);
+    }
+    std::vector<int> bondcluster;
+    std::vector<std::vector<char> > member;
+    nextlabel = top.rigidclusters(bondcluster, member);
+
+    // top-down: every top gasket sees the gadgets of all the others as its outside, and the clusters holding its
+    // corner pairs are looked up in the clusters of each corner
+    std::vector<std::vector<int> > clustersof(numcorners);
+    for (int m = 0; m < member.size(); m++) {
+        for (int k = 0; k < numcorners; k++) {
+            if (member[m][k]) {
+                clustersof[k].push_back(m);
+            }
+        }
+    }
+    std::vector<Gadget> outside(numtop);
+    PebbleGame rest;
+    for (int k = 0; k < numcorners; k++) {
+        rest.addvertex();
+    }
+    if (numtop > 0) {
+        complement(rest, topid, 0, numtop, outside);
+    }
+
+    bondlabel.assign(bondsite.size() / 2, -1);
+    for (int g = 0; g < numtop; g++) {
+        int v[3];
+        int label[3];
+        for (int k = 0; k < 3; k++) {
+            v[k] = topid[corners[n][3 * g + k]];
+        }
+        for (int k = 0; k < 3; k++) {
+            label[k] = -1;
+            const std::vector<int> &at = clustersof[v[k]];
+            for (int m = 0; m < at.size(); m++) {
+                if (member[at[m]][v[(k + 1) % 3]]) {
+                    label[k] = at[m];
+                    break;
+                }
+            }
+        }
+        descend(n, g, outside[g], label);
+    }
+
+    // sizes of the clusters, the giant one and whether it spans
+    std::vector<long long> labelsite;
+    for (int b = 0; b < bondlabel.size(); b++) {
+        if (bondlabel[b] >= 0) {
+            labelsite.push_back((long long) bondlabel[b] * size + bondsite[2 * b]);
+            labelsite.push_back((long long) bondlabel[b] * size + bondsite[2 * b + 1]);
+        }
+    }
+    std::sort(labelsite.begin(), labelsite.end());
+    labelsite.erase(std::unique(labelsite.begin(), labelsite.end()), labelsite.end());
+    std::vector<int> sites(nextlabel, 0);
+    for (int k = 0; k < labelsite.size(); k++) {
+        sites[labelsite[k] / size]++;
+    }
+
+    numclusters = 0;
+    giantlabel = -1;
+    giantsize_site = 0;
+    giantsize_bond = 0;
+    for (int label = 0; label < nextlabel; label++) {
+        if (sites[label] > 0) {
+            numclusters++;
+        }
+        if (sites[label] > giantsize_site) {
+            giantsize_site = sites[label];
+            giantlabel = label;
+        }
+    }
+    if (giantlabel != -1) {
+        giantsize_bond = 2 * giantsize_site - 3;
+    }
+    spanning = giantlabel != -1 && winds(giantlabel);
+    return spanning;
+}
+
+// descend labels the bonds inside gasket g of the given level, from the gadget of everything outside it and the
+// labels of the clusters that hold its corner pairs (-1 for a pair that isn't rigid)
+void SGHierarchy::descend(int level, int g, const Gadget &outside, const int *label)
+{
+    if (level == 0) {
+        for (int k = 0; k < 3; k++) {
+            if (gadgets[0][g].bar[k]) {
+                if (label[k] < 0) {
+                    std::cout << "A bond of the lattice was left out of every rigid cluster.\n";
+                }
+                bondlabel[3 * g + k] = label[k];
+            }
+        }
+        return;
+    }
+
+    const Gadget *child = &gadgets[level - 1][3 * g];
+    PebbleGame game;
+    for (int k = 0; k < 6; k++) {
+        game.addvertex();
+    }
+    addgadget(game, outside, 0, 1, 2);
+    for (int i = 0; i < 3; i++) {
+        addgadget(game, child[i], local[i][0], local[i][1], local[i][2]);
+    }
+    std::vector<int> bondcluster;
+    std::vector<std::vector<char> > member;
+    int numlocal = game.rigidclusters(bondcluster, member);
+
+    // a cluster holding two corners of this gasket is the one the outside already knows, the rest are new
+    std::vector<int> clusterlabel(numlocal, -1);
+    for (int m = 0; m < numlocal; m++) {
+        for (int k = 0; k < 3; k++) {
+            if (member[m][k] && member[m][(k + 1) % 3] && label[k] >= 0) {
+                clusterlabel[m] = label[k];
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int childlabel[3];
+        for (int k = 0; k < 3; k++) {
+            int u = local[i][k];
+            int v = local[i][(k + 1) % 3];
+            childlabel[k] = -1;
+            for (int m = 0; m < numlocal; m++) {
+                if (member[m][u] && member[m][v]) {
+                    if (clusterlabel[m] == -1) {
+                        clusterlabel[m] = nextlabel++;
+                    }
+                    childlabel[k] = clusterlabel[m];
+                    break;
+                }
+            }
+        }
+
+        PebbleGame rest;
+        for (int k = 0; k < 6; k++) {
+            rest.addvertex();
+        }
+        addgadget(rest, outside, 0, 1, 2);
+        for (int other = 0; other < 3; other++) {
+            if (other != i) {
+                addgadget(rest, child[other], local[other][0], local[other][1], local[other][2]);
+            }
+        }
+        descend(level - 1, 3 * g + i, contract(rest, local[i][0], local[i][1], local[i][2]), childlabel);
+    }
+}
+
+// winds unrolls the cluster by a breadth first search, the cluster spans if two of its sites meet with columns
+// that differ by a whole period of the lattice
+bool SGHierarchy::winds(int label)
+{
+    std::vector<std::vector<int> > adjacent(size);
+    for (int b = 0; b < bondlabel.size(); b++) {
+        if (bondlabel[b] == label) {
+            adjacent[bondsite[2 * b]].push_back(bondsite[2 * b + 1]);
+            adjacent[bondsite[2 * b + 1]].push_back(bondsite[2 * b]);
+        }
+    }
+
+    const int unseen = -2 * size;
+    std::vector<int> x(size, unseen);
+    for (int start = 0; start < size; start++) {
+        if (adjacent[start].empty() || x[start] != unseen) {
+            continue;
+        }
+        x[start] = 0;
+        std::vector<int> queue(1, start);
+        for (int head = 0; head < queue.size(); head++) {
+            int cl = queue[head];
+            for (int k = 0; k < adjacent[cl].size(); k++) {
+                int prosp = adjacent[cl][k];
+                int step = (col[prosp] - col[cl] + ll + 1) % ll - 1;
+                if (x[prosp] == unseen) {
+                    x[prosp] = x[cl] + step;
+                    queue.push_back(prosp);
+                }
+                else if (x[prosp] != x[cl] + step) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
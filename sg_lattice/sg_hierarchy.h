@@ -0,0 +1,71 @@
+//
+// Rigidity of a site diluted SG lattice solved gasket by gasket instead of with one flat pebble game
+//
+
+#ifndef PEBBLEGAMETEST_SG_HIERARCHY_H
+#define PEBBLEGAMETEST_SG_HIERARCHY_H
+
+#include <vector>
+#include "pebble_game.h"
+#include "vertex_index.h"
+
+// Every sub-gasket of the lattice meets the rest of it only at its three corners, so as far as the rest of the
+// lattice is concerned a gasket is fully described by the constraints it puts on its corners. Three points in
+// the plane have three internal degrees of freedom, and generically the constraints a gasket imposes are one of
+//   rank 0  nothing
+//   rank 1  a bar between two corners, or a "star" (an extra vertex bonded to all three corners)
+//   rank 2  two bars (a hinge), a bar and a star, or two stars
+//   rank 3  a rigid triangle
+// which is what a Gadget records: the rank and which corner pairs are held rigid (the rest of the rank is stars).
+//
+// solve() builds the gadget of every gasket bottom-up, each one from the gadgets of its three children, and
+// runs a pebble game on the gadgets of the top level gaskets only. A second pass goes back down, giving every
+// gasket the gadget of everything outside it, so the rigid clusters inside each gasket can be worked out on a
+// graph of a dozen vertices and labelled consistently with the clusters they join. The work per gasket is
+// bounded, so apart from the top level the cost is linear in the number of sites. At the top level the rigid
+// clusters of the s * s gaskets are found the flat way, and the outsides of the top gaskets all come from one
+// game by complement(), which plays each top gadget about log2(s * s) times.
+class SGHierarchy {
+public:
+    struct Gadget {
+        int rank = 0;
+        bool bar[3] = {false, false, false};    // corner pair k (corners k and k + 1) is held rigid
+    };
+
+    // build works out the gaskets from the neighbor table, neighbors[6 * site + d - 1] being the neighbor of
+    // site in direction d (-1 if there is none), as given by SiteRP::choosedir_sg. It needs a periodic lattice (s > 1)
+    bool build(int n_input, int s_input, const std::vector<int> &neighbors);
+    bool isbuilt() const { return built; }
+
+    // solve finds the rigid clusters of the occupied sites, and returns whether the giant one spans
+    bool solve(const sitestate_t *occ);
+
+    int numclusters = 0;
+    int giantlabel = -1;            // the label of the giant rigid cluster, -1 if there are no bonds
+    int giantsize_site = 0;         // sites in the giant rigid cluster
+    int giantsize_bond = 0;         // independent bonds in the giant rigid cluster, 2 * sites - 3 as it is rigid
+    bool spanning = false;
+
+    // the bonds of the lattice (the edges of the smallest triangles) and the rigid cluster of each, -1 when absent
+    std::vector<int> bondsite;      // bond b joins bondsite[2 * b] and bondsite[2 * b + 1]
+    std::vector<int> bondlabel;
+
+private:
+    void addgadget(PebbleGame &game, const Gadget &g, int a, int b, int c);
+    Gadget contract(PebbleGame &game, int a, int b, int c);
+    void complement(PebbleGame &game, const std::vector<int> &topid, int first, int last, std::vector<Gadget> &outside);
+    void descend(int level, int g, const Gadget &outside, const int *label);
+    bool winds(int label);
+
+    bool built = false;
+    int n = 0;
+    int s = 0;
+    int ll = 0;
+    int size = 0;
+    std::vector<int> col;                       // column of each site, in the frame where directions 3 and 6 keep it
+    std::vector<std::vector<int> > corners;     // corners[level][3 * g + k], the top, lower left and lower right corners
+    std::vector<std::vector<Gadget> > gadgets;  // gadgets[level][g], the gadgets of the last solve
+    int nextlabel = 0;
+};
+
+#endif //PEBBLEGAMETEST_SG_HIERARCHY_H
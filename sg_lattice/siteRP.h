@@ -6,13 +6,38 @@
 #define PEBBLEGAMETEST_SITERP_H
 
 #include <vector>
+#include <deque>
+#include <memory>
 #include <stack>
+#include <string>
+#include <ctime>
 #include <iostream>
 #include <fstream>
 #include "bond.h"
+#include "pc_stats.h"
+#include "snapshot.h"
+#include "sg_hierarchy.h"
+#include "pebble_game.h"
+#include "state_pages.h"
+#include "async_span.h"
+#include "worker_pool.h"
+#include "union_find.h"
+#include "lattice_cache.h"
+#include "site_store.h"
+#include "fixed_list.h"
+#include "render.h"
 #include "sg_connections.h"
 #include "one_open_sg.hpp"
 
+// The spanning test findspan() decides pc with. A rigid cluster wrapping around the lattice and the two bus bars
+// being rigid with each other through the lattice cut open at the seam are different events, which first happen at
+// different densities (the bars hold on one trial at 603 sites where the wrap comes at 612), so the pc of one test
+// is a different observable from the pc of the other, and their output files are kept apart by spantag()
+enum SpanTest {
+    SPAN_WRAP = 0,
+    SPAN_BUSBAR = 1
+};
+
 class SiteRP {
 
 
@@ -20,7 +45,12 @@ class SiteRP {
 
 // Fractal RP specific begin
 private:
-    static const int size = 637; // The number of vertices in the graph, ll*ll for triangular lattice
+    static const vertex_t size = 637; // The number of vertices in the graph, ll*ll for triangular lattice
+    // the per-site arrays are members and sites are counted with int in the loops, so the engine itself stays
+    // within int even where vertex_t is 64 bits
+    static_assert(size <= INT32_MAX, "the SiteRP engine holds at most 2^31 - 1 sites");
+    // the site numbers in the pebble graph, 16 bits for a lattice that small (see compact_vertex)
+    typedef compact_vertex<size>::type site_t;
 
 public:
     static const int n = 2;  // number of fractal iterations
@@ -29,29 +59,173 @@ public:
 // Fractal RP specific end
 
     int flag_for_span_check = 0;
+    double critical_pc = -1;     // the critical packing fraction of the current trial, -1 until a spanning cluster appears
     
-    short pc[size];                // Creates the pebble count at each vertex.
-    short occ[size];             // Says whether the site is occupied with a particle
+    // the flat per-site arrays, the pebble graph and the bonds are carved out of one block, which out_of_core moves
+    // into a file (site_store.h). No site has more than 6 bonds, which bounds every per-site list (fixed_list.h)
+    SiteStore sitestore{3 * size * sizeof(sitestate_t) + 5 * size * sizeof(int) + 6 * size * sizeof(vertex_t) + size +
+                        3 * SiteLists<site_t>::bytes(size, 6) + SiteLists<int>::bytes(size, 6) +
+                        3 * size * sizeof(Bond) + alignof(Bond) + sizeof(size_t) + 64};
+    sitestate_t *pc = sitestore.take<sitestate_t>(size);          // Creates the pebble count at each vertex.
+    sitestate_t *occ = sitestore.take<sitestate_t>(size);         // Says whether the site is occupied with a particle
+    sitestate_t *stressed = sitestore.take<sitestate_t>(size);    // Says whether the site is in an overconstrained (stressed) region
 
     int numparts;           // the number of particles (not pebbles) present in the system
     int numbonds;                    // The number of non-redundant bonds (original bonds and crossbraces) in the system
     int rbonds;                        // The number of redundant bonds in the system
+    int stressedsites;                 // The number of sites in overconstrained regions
+    int stressedbonds;                 // The number of non-redundant bonds in overconstrained regions (all redundant ones are too)
     float correlation;              // the correlation constant
     int giantsize_site;                  // The size of the giant rigid cluster
     int giantsize_bond;                  // The size of the giant rigid cluster
     int giantindex;                 // The index for the giant rigid cluster
     int SpanLastStatus;             // the last status of whether to have a spanning rigid cluster
 
-    std::vector<int> rcluster_site[size];     // Store all the information about rigid cluster decomposition in sites
-    std::vector<int> thegraph[size];        // thegraph is the graph of all loaded edges
-    std::vector<int> rgraph[size];        // rgraph is the graph of redundant bonds that don't take up any edges
-    std::vector<Bond> edges;             //bonds only contains loaded edges
-    std::vector<int> giantrigidcluster[size];    //giantrigidcluster is the graph for the giant rigid cluster
+    SiteLists<int> rcluster_site{sitestore, size, 6};     // Store all the information about rigid cluster decomposition in sites
+
+    // the rigid clusters of the last decomposition in CSR form. Clusters are numbered from 1 like Bond::RigidIndex
+    // (entry 0 is unused), and a site belongs to every cluster one of its bonds is in, so the clusters of site i
+    // are siteclusters[sitestart[i]] up to siteclusters[sitestart[i + 1] - 1]
+    struct ClusterTable {
+        int numclusters = 0;
+        std::vector<int> sites;            // the number of sites in each cluster
+        std::vector<int> bonds;            // the number of independent bonds in each cluster
+        std::vector<int> sitestart;        // size + 1 offsets into siteclusters
+        std::vector<int> siteclusters;
+    } clusters;
+    SiteLists<site_t> thegraph{sitestore, size, 6};        // thegraph is the graph of all loaded edges
+    SiteLists<site_t> rgraph{sitestore, size, 6};        // rgraph is the graph of redundant bonds that don't take up any edges
+    FixedList<Bond, size_t> edges{sitestore.take<Bond>(3 * size), sitestore.take<size_t>(1), 3 * size};   //bonds only contains loaded edges
+    SiteLists<site_t> giantrigidcluster{sitestore, size, 6};    //giantrigidcluster is the graph for the giant rigid cluster
     std::stack<int> placesbeen;            // The list of places been while looking for a pebble
+    int *searchstamp = sitestore.take<int>(size);    // a site has been visited by the current search if its stamp is searchnum
+    int searchnum = 0;
+    std::vector<int> searched;             // the sites the last findpebble or findfreepebble search has gone through
+    int *rigidmark = sitestore.take<int>(size);      // findfreepebble found no free pebble from here, if this is regionnum
+    int *floppymark = sitestore.take<int>(size);     // findfreepebble found a free pebble from here, if this is regionnum
+    // bondat[6 * i + d] is the index in edges of the independent bond from i in direction d + 1, for the first
+    // bondsindexed bonds of edges. Entries are checked against the bond they name, so stale ones are harmless, and
+    // anything that takes bonds out of edges only has to bring bondsindexed down
+    vertex_t *bondat = sitestore.take<vertex_t>(6 * size);
+    size_t bondsindexed = 0;
+    int regionnum = 1;                     // moves on whenever the graph changes or the pinned sites do, and at every reset
+    int regionpin1 = -1;                   // the sites whose pebbles the marks were found without
+    int regionpin2 = -1;
+    // the sites occupied since the last reset. Pebbles, edges, stress marks and the giant cluster only ever sit on
+    // occupied sites, so these and their neighbors are all a reset has to clear. trialsitesknown is false until the
+    // first reset and after state is loaded in bulk, and the reset then clears every site
+    std::vector<int> trialsites;
+    bool trialsitesknown = false;
+
+    // the undo journal, kept while journaling is on: every change made to the pebble game and the occupied sites,
+    // newest last, so that rollback() can take the engine back to a mark() by undoing them in reverse
+    enum ChangeKind { UNDO_PEBBLE, UNDO_ADDEDGE, UNDO_REMOVEEDGE, UNDO_BOND, UNDO_REDUNDANT, UNDO_OCCUPY,
+                      UNDO_STRESSEDSITE, UNDO_STRESSEDBOND };
+    struct Change {
+        char kind;
+        int i;          // the site (or the index in edges for UNDO_STRESSEDBOND)
+        int j;          // the other end of the edge, or the change in the pebble count
+        int k;          // where in thegraph[i] a removed edge was
+    };
+    bool journaling = false;
+    std::vector<Change> journal;
     std::ofstream myfile;                  // The file stream to output the mainly wanted info
     std::ofstream rclusterfile;            // the file stream to output the rigid cluster decomposition info
+    std::string myfilename;                // where myfile and rclusterfile currently point
+    std::string rclusterfilename;
+    PcStats pcstats;                       // running statistics of pc and phi for every correlation value of the run
+    unsigned int sweepseed = 0;            // base seed of a checkpointed sweep, job k of the sweep is seeded with sweepseed + k
+    long long rngdraws = 0;                // random numbers drawn since the last reseed, i.e. the position in the RNG stream
+    int checkpoint_interval = 600;         // seconds between checkpoints of a sweep, 0 turns checkpointing off
+    bool checkpoint_inflight = false;      // also checkpoint from inside long trials, saving a snapshot of the engine
+    bool snapshot_at_pc = false;           // save a snapshot of the engine at the critical point of every trial
+    bool picture_at_pc = false;            // draw the configuration at the critical point of every trial, see savepicture
+    int trialnum = 0;                      // the trial number last given to setfilestream
+    bool record_sequence = false;          // write the accepted sites of every trial to sequencename(c, trial)
+    std::vector<int> sequence;             // the sites accepted so far in this trial, when record_sequence is set
+    bool use_hierarchy = false;            // find the rigid clusters with the gasket by gasket solver instead of rigidcluster()
+    SGHierarchy hierarchy;                 // the gasket by gasket solver, built the first time it's used
+    bool giant_only = false;               // check for spanning with seamrcluster(), decomposing the whole lattice only to confirm
+    int giantseed = -1;                    // a seam bond of the largest cluster seamrcluster() last grew, -1 if none
+    std::vector<int> seamstart;            // seamrcluster()'s bonds at each site, as offsets into seambonds
+    std::vector<int> seambonds;
+    std::vector<int> seamcluster;          // the cluster seamrcluster() last put each site in
+    int *column = sitestore.take<int>(size);         // the column of each site across the direction spanning is checked in
+    bool columnsknown = false;             // whether column has been worked out yet
+    int span_test = SPAN_WRAP;             // the spanning test that decides pc, see SpanTest
+    PebbleGame openlattice;                // the lattice cut open at the seam, with the two bus bars, kept with SPAN_BUSBAR
+    bool async_span = false;               // run the spanning checks on snapshots in the background while deposition goes on
+    int async_backlog = 2;                 // the most checks left in flight before deposition waits for the analysis
+    AsyncSpan analyst;                     // the background thread doing them, started by the first check
+    std::shared_ptr<const StateSnapshot> published;   // the last snapshot published, whose clean pages the next one shares
+    char dirtypage[(size + PAGE_SITES - 1) / PAGE_SITES] = {};    // the site pages changed since then
+    std::vector<char> dirtybonds;          // and the pages of edges
+    long long checkepoch = 0;              // see StateSnapshot::epoch
+    int epochstatus = 0;                   // the spanning status the checks of this epoch follow on from
+
+    // a check in flight: the journal mark at its snapshot, where the occupied site list ended, and how many of
+    // the log lines held back come before it
+    struct PendingCheck {
+        int journalmark;
+        long long occsitesbytes;
+        int heldlines;
+    };
+    std::deque<PendingCheck> pendingchecks;
+    // the log lines of the sites placed after the oldest check in flight, which wait for its result to be written
+    struct HeldLine {
+        int numparts;
+        int numbonds;
+        int rbonds;
+    };
+    std::vector<HeldLine> heldlines;
+    int parallel_blocks = 0;               // with more than one, play the pebble game on that many blocks of strips at once
+    int *siteblock = sitestore.take<int>(size);      // the block of every site, made of whole strips of the lattice
+    int blocksknown = 0;                   // the number of blocks siteblock was worked out for, 0 if it hasn't been
+    std::vector<int> batch;                // sites occupied whose bonds wait for the next placebatch()
+    std::vector<int> batchposition;        // where each site is in batch while placebatch works, -1 otherwise
+    int rigid_threads = 0;                 // with more than one, rigidcluster() grows the clusters on that many threads (set it before the trial)
+    std::vector<std::unique_ptr<SiteRP> > clusterworkers;   // their engines, each playing its own copy of the pebble game
+    ConcurrentUnionFind sameclusters;      // the cluster ids the threads found to be the same cluster
+    bool lattice_cache = true;             // map the lattice from latticename(n, s), building the file if it isn't there
+    std::shared_ptr<const LatticeView> lattice;    // the neighbors and geometry of the lattice, shared by every engine
+    const vertex_t *neighbortable = nullptr;       // lattice->neighbors(), the 6 neighbors of each site in turn
+    int lattice_order = ORDER_LAYERS;      // the order the engine numbers the sites in, takes effect at the next trial
+    const vertex_t *tolegacy = nullptr;    // lattice->legacy(), the layer by layer number of each site, which files use
+    const vertex_t *fromlegacy = nullptr;  // lattice->site(), the site with each layer by layer number
+    const uint8_t *neighbormask = nullptr;     // lattice->mask(), bit d - 1 set if a site has a neighbor in direction d
+    const uint8_t *neighborcount = nullptr;    // lattice->degree(), how many neighbors each site has
+    uint8_t *occnear = sitestore.take<uint8_t>(size);   // bit d - 1 set while the neighbor in direction d is occupied
+    bool occnearknown = false;             // false once occ has been loaded wholesale, until findoccnear() catches up
+    double acceptance[7];                  // pow(1 - c, k), the chance of accepting a site with k empty neighbors
+    float acceptancec = -1;                // the c acceptance was worked out for
+    bool out_of_core = false;              // keep sitestore, the site arrays, graphs and bonds, in a file the kernel pages in as needed, and log page faults
+    // the visit stamps and path of a pebble search confined to one block, and the bonds of the block in the batch
+    // addbonds is adding, sorted into those it placed and those it couldn't. One per block, kept from batch to batch
+    struct BlockSearch {
+        std::vector<int> stamp;
+        int num = 0;
+        std::vector<int> path;
+        std::vector<std::pair<int, int> > inside;
+        std::vector<std::pair<int, int> > placed;
+        std::vector<std::pair<int, int> > unplaced;
+    };
+    std::vector<BlockSearch> blocksearches;
+    WorkerPool blockpool;                  // a thread per block, started with the blocks
+
+    // the sweep in progress, kept here so that a checkpoint can be written from inside a trial
+    struct Sweep {
+        float c1 = 0;
+        float c2 = 0;
+        float dc = 0;
+        int numtrials = 0;
+        std::vector<char> jobdone;         // which (c, trial) jobs are finished
+        int job = -1;                      // the job in flight, -1 between jobs
+        long long numattempts = 0;         // deposition attempts made by the job in flight
+        long long outputbytes[5] = {0, 0, 0, 0, 0};   // lengths of myfile, rclusterfile, pc_and_phi, occsites and backbone when saved
+        time_t lastcheckpoint = 0;
+    } sweep;
 private:
-    const int EMPTY = -size - 1;
+    const vertex_t EMPTY = -size - 1;
 public:
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -112,6 +286,9 @@ public:
 
 //Finding a neighboring site in a specific direction in the SG lattice
     int choosedir_sg(int site, int d);
+// loadlattice picks up the lattice table every engine of the process shares in lattice_order, see lattice_cache.h,
+// unless it has it already
+    void loadlattice();
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -156,6 +333,14 @@ public:
     bool findpebble(int i, int skip);
 
 
+// startsearch gets the visit stamps ready for a new search
+    void startsearch();
+
+// findfreepebble says whether a pebble other than those on pin1 and pin2 could be moved onto i, without moving it
+// (with three pebbles pinned on a bond, i is rigid with the bond when it can't be). It marks the sites it went
+// through, so later searches on the same graph can stop early
+    bool findfreepebble(int i, int pin1, int pin2);
+
 // loadsite looks for pebbles and moves them onto i until i has two pebbles or it stops finding pebbles
     bool loadsite(int i);
 
@@ -165,19 +350,97 @@ public:
 // loadsites tries to move pebbles until there are two on both sites i and j
     bool loadsites(int i, int j);
 
+// findblocks splits the lattice into numblocks blocks of whole strips (the rows of SGs laid out by
+// SG_StripVertList and SG_LatticeVertList), which are runs of consecutive sites, and sets up the search and the
+// thread of each block
+    void findblocks(int numblocks);
+
+// blockfindpebble and blockloadsites are findpebble and loadsites for a search that never leaves block, so that
+// the blocks can be searched at once by different threads. A bond they manage to load is independent in the
+// whole lattice too, one they can't may still get pebbles from outside the block
+    bool blockfindpebble(int i, int skip, int block, BlockSearch &search);
+    bool blockloadsites(int i, int j, int block, BlockSearch &search);
+
+// addbonds adds the bonds i j like addbond does, those inside a block in parallel on blockpool, and
+// then the ones across blocks and the ones a block couldn't load on its own. The independent bonds found are
+// the same as adding them one by one, only their order in edges differs. With the journal on it adds them one
+// by one, since the threads don't record their changes
+    void addbonds(const std::vector<std::pair<int, int> > &bonds);
+
+// placebatch adds the bonds of the sites placesite has queued in batch, as if they had been placed one by one
+    void placebatch();
+
+// rebuildbyblocks plays the pebble game again from scratch on the occupied sites, block by block
+    void rebuildbyblocks();
+
+// markstressed marks the overconstrained region a redundant bond i j has just made, from the failed search of loadsites
+    void markstressed(int i, int j);
+    // indexbonds brings bondat up to date with the bonds added to edges since it last ran
+    void indexbonds();
+
 // addbond tries to load the sites. If it succeeds, it adds an edge from i to j and takes a pebble from i. Otherwise, it adds a redundant edge
     void addbond(int i, int j);
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// UNDO JOURNAL
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// record adds a change to the journal, if journaling is on
+    void record(char kind, int i, int j = 0, int k = 0) {
+        if (journaling) {
+            journal.push_back(Change{kind, i, j, k});
+        }
+        if (async_span || rigid_threads > 1) {
+            touch(kind, i);
+        }
+    }
+
+// touch marks the page a change lands on, so that the next published snapshot copies it instead of sharing it
+    void touch(char kind, int i) {
+        if (kind == UNDO_BOND || kind == UNDO_STRESSEDBOND) {
+            size_t b = (kind == UNDO_BOND ? edges.size() - 1 : i) / PAGE_BONDS;
+            if (b >= dirtybonds.size()) {
+                dirtybonds.resize(b + 1, 1);
+            }
+            dirtybonds[b] = 1;
+        }
+        else if (kind != UNDO_REDUNDANT) {
+            dirtypage[i / PAGE_SITES] = 1;
+        }
+    }
+
+// mark turns journaling on and returns a point in the journal that rollback can take the engine back to.
+// Marks nest, rolling back to an earlier one undoes everything since the later ones too
+    int mark();
+
+// rollback undoes the pebble moves, edges, bonds, occupied sites and stress marks made since the mark, newest
+// first, in time proportional to their number. The rigid cluster labels aren't journaled, the next decomposition
+// redoes them
+    void rollback(int m);
+
+// endjournal keeps the changes, drops the journal and turns journaling off again
+    void endjournal();
+
+// wouldberedundant says whether a bond between i and j would be redundant, like isredundant, but puts back the
+// pebbles it moved to find out
+    bool wouldberedundant(int i, int j);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 // REPORTING TO SCREEN
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    void setfilestream(float cval, int tval);
+    void setfilestream(float cval, int tval, bool append = false);
     void log(int span = -1);
+    // logline writes one line of the per-site output, with the counters and giant cluster of a site placement
+    void logline(int parts, int bonds, int redundant, int span);
 
 // listedges lists the edges from site i
     void listedges(int i);
@@ -217,12 +480,116 @@ public:
 // initgiantrigidcluster() initializes the giantrigidcluster graph
     void initgiantrigidcluster();
 
-// initemptytrigraph() updates numbonds, rbonds, thegraph, rgraph, placesbeen to a triangular graph with no particles or bonds
+// initemptytrigraph() updates numbonds, rbonds, thegraph, rgraph, placesbeen to a triangular graph with no particles or bonds.
+// It takes time in the number of sites the last trial occupied rather than the size of the lattice (see trialsites)
     int initemptytrigraph();
+
+// clearsite empties the pebble game state of site and the occupied neighbor marks around it
+    void clearsite(int site);
     // equivalent function for an SG lattice
     void addtricluster2_sg(int site, float c);
+    // placesite occupies site and bonds it to its occupied neighbors, checkspan then runs the rigidity analysis
+    // and records pc at the first spanning cluster. Together they are everything addtricluster2_sg does once a site is accepted.
+    // With parallel_blocks the bonds wait in batch for the next check, which adds them all at once with addbonds
+    void placesite(int site);
+    // accepted is the correlated acceptance test of a site: its empty neighbors are the bits of neighbormask not set
+    // in occnear, and the chance pow(1 - c, k) of accepting it with k of them is looked up in acceptance
+    bool accepted(int site, float c);
+    // markneighbors sets (or clears) the bit of site in occnear at each of its neighbors, findoccnear works all of
+    // occnear out again from occ
+    void markneighbors(int site, bool occupied);
+    void findoccnear();
+    void checkspan(float c);
+    // findspan runs the spanning test the engine is set up for and returns whether the lattice spans. With
+    // SPAN_BUSBAR the rigid clusters are only found at the check where the bars first hold, for the statistics at pc
+    int findspan();
+    // recordcritical writes pc, phi, the stressed backbone and the cluster statistics of the critical point just found
+    void recordcritical(float c);
     void onetritrial2(long long int maxout, float c);
-    void multictrial(long long int maxout, float c1, float c2, float dc, int numtrials);
+    // with resume, multictrial picks up the sweep recorded in checkpointname() and skips the jobs it finished
+    void multictrial(long long int maxout, float c1, float c2, float dc, int numtrials, bool resume = false);
+    // onectrial runs a single trial of a sweep and returns its critical packing fraction (-1 if it never spans)
+    // with stopatspan it quits depositing as soon as the first spanning rigid cluster appears
+    double onectrial(long long int maxout, float c, int trial, bool stopatspan);
+    // deposit keeps adding sites to the current trial, counting attempts in sweep.numattempts
+    void deposit(long long int maxout, float c, bool stopatspan);
+    // adaptivectrial spends trials where the standard error of pc is still above target_se, after mintrials at every c,
+    // and stops a correlation value once it has converged or used maxtrials
+    void adaptivectrial(long long int maxout, float c1, float c2, float dc, int mintrials, int maxtrials, double target_se);
+    // file that the running pc statistics of a sweep are merged into, pc_summary_n{n}s{s}{spantag}.txt
+    std::string summaryname();
+    // file that the pc and phi of every trial are appended to, pc_and_phi_n{n}s{s}{spantag}.txt
+    std::string pcphiname();
+    // file that the stressed backbone of every trial at pc is appended to, backbone_n{n}s{s}{spantag}.txt
+    std::string backbonename();
+    // file that the page faults of every trial are appended to with out_of_core set, faults_n{n}s{s}.txt
+    std::string faultsname();
+    // what the names of the files holding pc and the statistics at it end in, "_busbar" with SPAN_BUSBAR and
+    // nothing with SPAN_WRAP, so that a sweep never merges the pc of one test into that of the other
+    std::string spantag();
+
+    // a checkpoint records the sweep parameters, its seed, which (c, trial) jobs are finished, and the pc statistics
+    // gathered by them so far, with the lengths of the files the sweep appends to, it's written every checkpoint_interval
+    // seconds and removed when the sweep completes.
+    // With checkpoint_inflight it also names the trial in flight, whose engine state goes to checkpointname() + ".snap",
+    // and readcheckpoint refuses a checkpoint whose snapshot doesn't have the same number of random draws
+    std::string checkpointname();
+    bool writecheckpoint();
+    bool readcheckpoint();
+    // cutoutputs cuts the files the sweep appends to back to their lengths at the checkpoint, and with inflight
+    // the two files of the trial resumed from it too
+    void cutoutputs(bool inflight);
+
+    // the recorded insertion sequence of trial t at correlation c goes to sequence_n{n}s{s}_c{c}t{t}.bin (see snapshot.h)
+    std::string sequencename(float cval, int tval);
+    bool writesequence(const std::string &filename);
+    // replaytrial reruns the rigidity analysis of a recorded trial, placing its sites in order with no random numbers
+    // and no acceptance tests, and returns its critical packing fraction (-1 if it never spans)
+    double replaytrial(const std::string &filename);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SNAPSHOTS OF THE ENGINE STATE
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // savesnapshot writes pc, occ, the pebble and redundant graphs, the independent bonds with their rigid
+    // indices, the giant rigid cluster, rcluster_site and the counters to a binary file (see snapshot.h)
+    bool savesnapshot(const std::string &filename);
+    // loadsnapshot maps a snapshot and copies it into the engine, it refuses snapshots of a different lattice
+    bool loadsnapshot(const std::string &filename);
+    // the file a snapshot at the critical point of trial t at correlation c goes to, snapshot_n{n}s{s}_c{c}t{t}.bin
+    std::string snapshotname(float cval, int tval);
+    // savepicture draws the lattice, the occupied sites, the independent and redundant bonds and the giant rigid
+    // cluster of the last decomposition to a PPM image, or SVG if filename ends in .svg, width pixels across (see render.h)
+    bool savepicture(const std::string &filename, int width = 1200);
+    // picture_n{n}s{s}_c{c}t{t}.ppm, where picture_at_pc draws the critical point of trial t at correlation c
+    std::string picturename(float cval, int tval);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// SPANNING CHECKS IN THE BACKGROUND
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // publishstate makes an immutable snapshot of the engine (see state_pages.h), sharing the pages that haven't
+    // changed since the last one
+    std::shared_ptr<const StateSnapshot> publishstate();
+    // loadstate copies a snapshot into the engine, as the state the next spanning check runs on
+    void loadstate(const StateSnapshot &snap);
+    // newepoch forgets the checks in flight, whose results no longer apply, and starts the next run of checks
+    // from spanning status spanlast
+    void newepoch(int spanlast);
+    // submitcheck marks the journal, publishes a snapshot and hands it to the analyst, in place of a spanning check
+    void submitcheck(float c);
+    // collectchecks takes in the results of the checks in flight, waiting while more than leave are left. At the
+    // first that spans it rolls the engine back to that check's snapshot, records the critical point there, and
+    // returns true, since the sites placed after it are gone
+    bool collectchecks(float c, int leave);
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -235,6 +602,33 @@ public:
     bool isredundant(int i, int j);  //see if the test bond between (i,j) is redundant(dependent)
     bool isbondrigid(Bond &a, Bond &b); //see if the two bonds a and b are rigid to each other
     void rigidcluster(); // mark the rigid clusters
+    // threadedclusters labels the bonds with their rigid clusters like rigidcluster() does, numbered the same, using
+    // rigid_threads threads that each play a copy of the pebble game, and returns the number of clusters, or -1 if a
+    // seed bond held four pebbles and rigidcluster() has to label them serially instead
+    int threadedclusters();
+    // fillclusters builds the cluster table from the (site, cluster) pairs of a decomposition, which may repeat
+    void fillclusters(const std::vector<std::pair<int, int> > &membership, int numclusters);
+    // hierarchicalrcluster finds the giant rigid cluster with the hierarchical solver (see sg_hierarchy.h), fills in
+    // giantrigidcluster with its independent bonds and the giant sizes like rigidcluster() does, and returns whether it spans
+    bool hierarchicalrcluster();
+    // findcolumns takes the column of every site from the lattice table, which counts steps in directions 1 and 2 as
+    // +1 and in 4 and 5 as -1 modulo ll, so that a rigid cluster can only wrap around the lattice through a bond
+    // from column ll - 1 to 0
+    void findcolumns();
+    bool crossesseam(int i, int j);
+    // seamrcluster grows only the rigid clusters that hold a bond across the seam, the one holding giantseed
+    // first, and stops at the first one that spans, which it returns. giantrigidcluster and the giant sizes are
+    // left holding the largest cluster it grew, which need not be the giant cluster of the whole lattice
+    bool seamrcluster();
+    // buildopenlattice puts the bonds of thegraph that don't cross the seam into openlattice, after the sites and
+    // the bus bars, a bond between two extra vertices on each side (size and size + 1 for the first column,
+    // size + 2 and size + 3 for the last). With SPAN_BUSBAR addbond keeps it up to date from then on
+    void buildopenlattice();
+    // busbarspan ties the occupied sites of the first and last columns to their bus bars with ghost bonds and asks
+    // whether the two bars are then rigid with each other through the open lattice. Everything the test did to
+    // openlattice, the ghost bonds and the pebbles it moved, is rolled back before it returns. It is the boundary to
+    // boundary test of spanning, rather than the wrapping one of spanningrcluster()
+    bool busbarspan();
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -300,7 +694,19 @@ public:
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     void OneTrialTest(float cfor, int trial); //Generate one-time trial for triangular lattice (site RP)
-    void MultiTrialTest(); //Generate multiple-times trial for triangular lattice (site RP)
+    void MultiTrialTest(bool resume = false); //Generate multiple-times trial for triangular lattice (site RP)
+    void AdaptiveTrialTest(); //Generate trials until pc is known to a target precision at each correlation value
+    void HierarchyTest(); //Compare the hierarchical solver with the pebble game along one trial
+    void GiantOnlyTest(); //Compare the giant only spanning check with the whole decomposition along one trial
+    void BusBarTest(); //Compare the bus bar spanning test with the wrapping one along one trial
+    void JournalTest(); //Place sites speculatively along one trial and check that rolling them back restores the engine
+    void AsyncSpanTest(); //Compare the critical points of trials checked in the background with checking them in line
+    void BlockGameTest(); //Compare the pebble game played block by block with the serial one along one trial
+    void ThreadedClusterTest(); //Compare the rigid clusters grown on several threads with rigidcluster() along a random trial and the one of seed 11
+    void LatticeCacheTest(); //Compare the mapped lattice table with working every neighbor out with DoEverything, and the table built serially with the one built by strips
+    void RenderTest(); //Draw a trial at its critical point as a PPM image and as SVG
+    void LatticeOrderTest(); //Compare a trial played on the lattice in Morton order with the same trial layer by layer
+    void ResetTest(); //Play short trials back to back and check that each reset of only the sites used leaves the engine empty
     void PlotNetworkTest(); //Generate network plot file
     //void ContinousNetworkRPTest();
 
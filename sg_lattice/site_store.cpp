@@ -0,0 +1,89 @@
+//
+// The block of memory the flat per-site arrays of a SiteRP live in, which can be backed by a file
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "site_store.h"
+
+SiteStore::SiteStore(size_t bytes)
+{
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    length = (bytes + page - 1) / page * page;
+    void *region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    base = region == MAP_FAILED ? nullptr : (char *) region;
+    if (base == nullptr) {
+        std::cout << "I couldn't map " << length << " bytes for the site arrays.\n";
+    }
+}
+
+SiteStore::~SiteStore()
+{
+    if (base != nullptr) {
+        munmap(base, length);
+    }
+}
+
+bool SiteStore::tofile(const std::string &filename)
+{
+    if (filebacked || base == nullptr) {
+        return filebacked;
+    }
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        std::cout << "I couldn't create " << filename << " to keep the site arrays in.\n";
+        return false;
+    }
+    unlink(filename.c_str());                   // the mapping keeps the file alive on its own
+    bool done = remap(fd);
+    close(fd);
+    if (!done) {
+        std::cout << "I couldn't map " << filename << " over the site arrays, they stay in memory.\n";
+    }
+    filebacked = done;
+    return done;
+}
+
+bool SiteStore::tomemory()
+{
+    if (!filebacked) {
+        return true;
+    }
+    bool done = remap(-1);
+    filebacked = !done;
+    return done;
+}
+
+// The new mapping replaces the old one in place (MAP_FIXED), which is what keeps every pointer into the arrays
+// valid, and the contents are put back into it from a copy
+bool SiteStore::remap(int fd)
+{
+    if (fd >= 0 && ftruncate(fd, length) != 0) {
+        return false;
+    }
+    std::vector<char> contents(base, base + length);
+    void *region = mmap(base, length, PROT_READ | PROT_WRITE,
+                        fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED : MAP_SHARED | MAP_FIXED, fd, 0);
+    if (region != base) {
+        return false;
+    }
+    std::copy(contents.begin(), contents.end(), base);
+    return true;
+}
+
+FaultCount FaultCount::now()
+{
+    FaultCount count;
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        count.minor = usage.ru_minflt;
+        count.major = usage.ru_majflt;
+    }
+    return count;
+}
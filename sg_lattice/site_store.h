@@ -0,0 +1,51 @@
+//
+// The block of memory the flat per-site arrays of a SiteRP live in, which can be backed by a file
+//
+
+#ifndef PEBBLEGAMETEST_SITE_STORE_H
+#define PEBBLEGAMETEST_SITE_STORE_H
+
+#include <cstddef>
+#include <string>
+
+// A SiteStore is one mapping that the per-site arrays of an engine are carved out of in turn with take(). It
+// starts out as ordinary (anonymous) memory. tofile() copies it into a file and maps the file over the same
+// addresses, so the arrays don't move, and from then on the kernel pages the state in from the file as it is
+// touched and can write it back out under memory pressure instead of holding all of it in RAM. The file is
+// unlinked as soon as it is mapped, so nothing is left behind however the run ends
+class SiteStore {
+public:
+    explicit SiteStore(size_t bytes);
+    ~SiteStore();
+    SiteStore(const SiteStore &) = delete;
+    SiteStore &operator=(const SiteStore &) = delete;
+
+    template <class T> T *take(size_t count) {
+        used = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+        T *array = (T *) (base + used);
+        used += count * sizeof(T);
+        return array;
+    }
+
+    bool tofile(const std::string &filename);   // false, and still in memory, if the file can't be made
+    bool tomemory();
+    bool isfile() const { return filebacked; }
+
+private:
+    bool remap(int fd);
+
+    char *base;
+    size_t length;                  // whole pages
+    size_t used = 0;
+    bool filebacked = false;
+};
+
+// the page faults the calling thread has taken so far, minor ones (the page was in memory already) and major
+// ones (it had to be read in)
+struct FaultCount {
+    long minor = 0;
+    long major = 0;
+    static FaultCount now();
+};
+
+#endif //PEBBLEGAMETEST_SITE_STORE_H
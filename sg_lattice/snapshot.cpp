@@ -0,0 +1,160 @@
+//
+// Binary snapshots of the complete pebble game state of a SiteRP
+//
+
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+
+// whether count entries of the given size and alignment, starting offset bytes into a file of length bytes, lie
+// inside it
+static bool fits(uint64_t offset, uint64_t count, uint64_t bytes, uint64_t align, uint64_t length)
+{
+    return offset % align == 0 && offset <= length && count <= (length - offset) / bytes;
+}
+
+// The extent of every section is checked against the file, and every CSR section's offsets against its entries,
+// so that the pointers the view hands out never run past the mapping however the file was cut short or damaged.
+// Every site a bond or a site list names is checked to be a site of the lattice too, as the engine indexes with them
+static bool sectionsfit(const SnapshotHeader &h, uint64_t length)
+{
+    if (h.size <= 0 || h.offset[SECTION_PC] == 0 || h.offset[SECTION_OCC] == 0 || h.offset[SECTION_EDGES] == 0) {
+        return false;
+    }
+    uint64_t size = uint64_t(h.size);
+    const SnapshotSection persite[] = {SECTION_PC, SECTION_OCC, SECTION_STRESSED};
+    for (int k = 0; k < 3; k++) {
+        if (h.offset[persite[k]] != 0 &&
+            (h.count[persite[k]] != size || !fits(h.offset[persite[k]], size, sizeof(int16_t), alignof(int16_t), length))) {
+            return false;
+        }
+    }
+    uint64_t numedges = h.count[SECTION_EDGES];
+    if (!fits(h.offset[SECTION_EDGES], numedges, sizeof(SnapshotBond), alignof(SnapshotBond), length)) {
+        return false;
+    }
+    const SnapshotBond *bonds = (const SnapshotBond *) ((const char *) &h + h.offset[SECTION_EDGES]);
+    for (uint64_t k = 0; k < numedges; k++) {
+        if (bonds[k].first < 0 || bonds[k].first >= h.size || bonds[k].second < 0 || bonds[k].second >= h.size) {
+            return false;
+        }
+    }
+    if (h.offset[SECTION_STRESSEDEDGES] != 0 &&
+        (h.count[SECTION_STRESSEDEDGES] != numedges || !fits(h.offset[SECTION_STRESSEDEDGES], numedges, 1, 1, length))) {
+        return false;
+    }
+
+    const SnapshotSection lists[] = {SECTION_GRAPH, SECTION_RGRAPH, SECTION_GIANT, SECTION_RCLUSTER};
+    for (int k = 0; k < 4; k++) {
+        uint64_t offset = h.offset[lists[k]];
+        if (offset == 0) {
+            continue;
+        }
+        if (!fits(offset, size + 1, sizeof(uint64_t), alignof(uint64_t), length)) {
+            return false;
+        }
+        uint64_t entriesat = offset + (size + 1) * sizeof(uint64_t);
+        if (!fits(entriesat, h.count[lists[k]], sizeof(int32_t), alignof(int32_t), length)) {
+            return false;
+        }
+        // each list starts where the one before it ends, and the last ends at the number of entries
+        const uint64_t *offsets = (const uint64_t *) ((const char *) &h + offset);
+        if (offsets[0] != 0 || offsets[size] != h.count[lists[k]]) {
+            return false;
+        }
+        for (uint64_t i = 0; i < size; i++) {
+            if (offsets[i + 1] < offsets[i]) {
+                return false;
+            }
+        }
+        if (lists[k] == SECTION_RCLUSTER) {                 // its entries are cluster numbers rather than sites
+            continue;
+        }
+        const int32_t *entries = (const int32_t *) ((const char *) &h + entriesat);
+        for (uint64_t e = 0; e < h.count[lists[k]]; e++) {
+            if (entries[e] < 0 || entries[e] >= h.size) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+SnapshotView::SnapshotView()
+{
+    base = nullptr;
+    length = 0;
+}
+
+SnapshotView::~SnapshotView()
+{
+    close();
+}
+
+bool SnapshotView::open(const std::string &filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "I couldn't open the snapshot " << filename << ".\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof(SnapshotHeader)) {
+        std::cout << "The snapshot " << filename << " is too short to hold a header.\n";
+        ::close(fd);
+        return false;
+    }
+
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);                                // the mapping keeps the file alive on its own
+    if (mapped == MAP_FAILED) {
+        std::cout << "I couldn't map the snapshot " << filename << ".\n";
+        return false;
+    }
+    base = (const char *) mapped;
+    length = st.st_size;
+
+    const SnapshotHeader &h = header();
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || h.byteorder != SNAPSHOT_BYTEORDER ||
+        h.version == 0 || h.version > SNAPSHOT_VERSION || h.headerbytes > length) {
+        std::cout << "The file " << filename << " isn't a snapshot this version can read.\n";
+        close();
+        return false;
+    }
+    for (int section = 0; section < NUM_SECTIONS_MAX; section++) {
+        if (h.offset[section] > length) {
+            std::cout << "The snapshot " << filename << " is truncated.\n";
+            close();
+            return false;
+        }
+    }
+    if (!sectionsfit(h, length)) {
+        std::cout << "The snapshot " << filename << " is truncated or damaged, a section runs past its end or names a site that isn't there.\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotView::close()
+{
+    if (base != nullptr) {
+        munmap((void *) base, length);
+    }
+    base = nullptr;
+    length = 0;
+}
+
+const int32_t *SnapshotView::list(SnapshotSection section, int i, int &length) const
+{
+    const uint64_t *offsets = (const uint64_t *) at(section);
+    const int32_t *entries = (const int32_t *) (offsets + header().size + 1);
+    length = int(offsets[i + 1] - offsets[i]);
+    return entries + offsets[i];
+}
@@ -0,0 +1,119 @@
+//
+// Binary snapshots of the complete pebble game state of a SiteRP
+//
+
+#ifndef PEBBLEGAMETEST_SNAPSHOT_H
+#define PEBBLEGAMETEST_SNAPSHOT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// A snapshot file is the header below followed by 8-byte aligned sections, so that every section can be used
+// in place once the file is memory mapped. Per-site lists (the pebble graph, the redundant graph, the giant
+// rigid cluster and the rigid indices of the sites) are stored in CSR form: size + 1 uint64 offsets followed by
+// the int32 entries. All numbers are in the byte order of the machine that wrote the file, which byteorder records.
+
+static const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'P', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t SNAPSHOT_VERSION = 2;
+static const uint32_t SNAPSHOT_BYTEORDER = 0x01020304;
+
+enum SnapshotSection {
+    SECTION_PC = 0,         // int16[size]  pebbles at each site
+    SECTION_OCC,            // int16[size]  occupation of each site
+    SECTION_EDGES,          // SnapshotBond[numedges]  the independent bonds in insertion order
+    SECTION_GRAPH,          // CSR  thegraph, the directed pebble graph
+    SECTION_RGRAPH,         // CSR  rgraph, the redundant bonds
+    SECTION_GIANT,          // CSR  giantrigidcluster
+    SECTION_RCLUSTER,       // CSR  rcluster_site
+    SECTION_STRESSED,       // int16[size]  whether each site is in an overconstrained region (version 2 on)
+    SECTION_STRESSEDEDGES,  // uint8[numedges]  whether each independent bond is (version 2 on)
+    NUM_SECTIONS_MAX = 16   // room for sections added by later versions, unused entries are zero
+};
+
+struct SnapshotBond {
+    int32_t first;
+    int32_t second;
+    int32_t RigidIndex;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    uint64_t headerbytes;       // sizeof(SnapshotHeader) of the writer
+
+    int32_t n;
+    int32_t s;
+    int32_t size;
+    int32_t ll;
+
+    int32_t numparts;
+    int32_t numbonds;
+    int32_t rbonds;
+    int32_t giantsize_site;
+    int32_t giantsize_bond;
+    int32_t giantindex;
+    int32_t SpanLastStatus;
+    int32_t flag_for_span_check;
+    float correlation;
+    uint32_t sweepseed;
+    double critical_pc;
+    int64_t rngdraws;
+
+    uint64_t offset[NUM_SECTIONS_MAX];  // byte offset of each section from the start of the file, 0 if absent
+    uint64_t count[NUM_SECTIONS_MAX];   // number of entries (for CSR sections, the total number of list entries)
+};
+
+// A sequence file records the sites a trial accepted, in the order they were occupied, so the trial can be
+// replayed into the pebble game without drawing any random numbers. The header below is followed by count
+// site indices, as uint16 when width is 2 (lattices of up to 65536 sites) and as int32 when width is 4.
+
+static const char SEQUENCE_MAGIC[8] = {'S', 'R', 'P', 'S', 'E', 'Q', '\0', '\0'};
+static const uint32_t SEQUENCE_VERSION = 1;
+
+struct SequenceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    int32_t n;
+    int32_t s;
+    int32_t size;
+    int32_t trial;
+    float correlation;
+    uint32_t width;             // bytes per site index
+    uint64_t count;             // number of sites in the sequence
+};
+
+// SnapshotView maps a snapshot file read-only and hands out pointers straight into the mapping, so analyses
+// can run on a saved configuration without copying it and several processes can share the pages
+class SnapshotView {
+public:
+    SnapshotView();
+    ~SnapshotView();
+
+    bool open(const std::string &filename);     // maps the file and checks its magic, version, byte order, that every section fits in it and that every site it names is on the lattice
+    void close();
+    bool isopen() const { return base != nullptr; }
+
+    const SnapshotHeader &header() const { return *(const SnapshotHeader *) base; }
+    bool has(SnapshotSection section) const { return header().offset[section] != 0; }
+
+    const int16_t *pc() const { return (const int16_t *) at(SECTION_PC); }
+    const int16_t *occ() const { return (const int16_t *) at(SECTION_OCC); }
+    const SnapshotBond *edges() const { return (const SnapshotBond *) at(SECTION_EDGES); }
+    const int16_t *stressed() const { return (const int16_t *) at(SECTION_STRESSED); }
+    const uint8_t *stressededges() const { return (const uint8_t *) at(SECTION_STRESSEDEDGES); }
+    uint64_t numedges() const { return header().count[SECTION_EDGES]; }
+
+    // the list of site i in the CSR section, returned as a pointer to its first entry and its length
+    const int32_t *list(SnapshotSection section, int i, int &length) const;
+
+private:
+    const char *at(SnapshotSection section) const { return base + header().offset[section]; }
+
+    const char *base;
+    size_t length;
+};
+
+#endif //PEBBLEGAMETEST_SNAPSHOT_H
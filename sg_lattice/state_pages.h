@@ -0,0 +1,42 @@
+//
+// Immutable snapshots of the pebble game state that share their unchanged pages, for analysis on another thread
+//
+
+#ifndef PEBBLEGAMETEST_STATE_PAGES_H
+#define PEBBLEGAMETEST_STATE_PAGES_H
+
+#include <memory>
+#include <vector>
+#include "bond.h"
+
+// A StateSnapshot holds what the rigidity analysis reads from a SiteRP: the pebble counts, occupation, stress
+// marks and pebble graph of every site, the independent bonds and the counters. Sites go in pages of PAGE_SITES
+// and bonds in pages of PAGE_BONDS. Once published a page is never written again, and the next snapshot takes
+// the same page (by pointer) unless the engine has changed something on it since, so publishing costs a copy of
+// the pages touched in between rather than of the whole lattice, and a snapshot stays valid for as long as
+// anyone holds it, whatever the engine does next
+static const int PAGE_SITES = 64;
+static const int PAGE_BONDS = 256;
+
+struct StatePage {
+    sitestate_t pc[PAGE_SITES];
+    sitestate_t occ[PAGE_SITES];
+    sitestate_t stressed[PAGE_SITES];
+    std::vector<vertex_t> graph[PAGE_SITES];
+};
+
+struct StateSnapshot {
+    long long epoch = 0;        // moves on when the trial restarts or is rolled back, so stale analyses can be told apart
+    int spanlast = 0;           // the spanning status and giant cluster sizes the first check of the epoch follows on from
+    int giantsize_bond = 0;
+    int giantsize_site = 0;
+    int numparts = 0;
+    int numbonds = 0;
+    int rbonds = 0;
+    int stressedsites = 0;
+    int stressedbonds = 0;
+    std::vector<std::shared_ptr<const StatePage> > pages;
+    std::vector<std::shared_ptr<const std::vector<Bond> > > bondpages;
+};
+
+#endif //PEBBLEGAMETEST_STATE_PAGES_H
@@ -0,0 +1,51 @@
+//
+// A union-find over cluster ids that several threads can merge into at once
+//
+
+#include "union_find.h"
+
+void ConcurrentUnionFind::reset(int n)
+{
+    if (n > count) {
+        parent.reset(new std::atomic<int>[n]);
+        count = n;
+    }
+    for (int x = 0; x < n; x++) {
+        parent[x].store(x);
+    }
+}
+
+int ConcurrentUnionFind::find(int x)
+{
+    while (true) {
+        int p = parent[x].load();
+        if (p == x) {
+            return x;
+        }
+        int gp = parent[p].load();
+        if (gp != p) {
+            parent[x].compare_exchange_weak(p, gp);
+        }
+        x = gp;
+    }
+}
+
+void ConcurrentUnionFind::unite(int a, int b)
+{
+    while (true) {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return;
+        }
+        if (a > b) {
+            int t = a;
+            a = b;
+            b = t;
+        }
+        int expected = b;
+        if (parent[b].compare_exchange_strong(expected, a)) {
+            return;
+        }
+    }
+}
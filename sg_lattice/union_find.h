@@ -0,0 +1,26 @@
+//
+// A union-find over cluster ids that several threads can merge into at once
+//
+
+#ifndef PEBBLEGAMETEST_UNION_FIND_H
+#define PEBBLEGAMETEST_UNION_FIND_H
+
+#include <atomic>
+#include <memory>
+
+// ConcurrentUnionFind keeps its parent links in atomics. find halves the path it walks with a compare and swap,
+// which only ever points a link further up the same tree, and unite links one root under the other only if it
+// is still a root, retrying otherwise, so no lock is needed. The smaller id always ends up the root, which makes
+// the result independent of the order the threads got there in
+class ConcurrentUnionFind {
+public:
+    void reset(int n);                      // n singleton sets, 0 to n - 1
+    int find(int x);
+    void unite(int a, int b);
+
+private:
+    std::unique_ptr<std::atomic<int>[]> parent;
+    int count = 0;
+};
+
+#endif //PEBBLEGAMETEST_UNION_FIND_H
@@ -0,0 +1,34 @@
+//
+// The integer types vertex (site) numbers and the state of a site are held in
+//
+
+#ifndef PEBBLEGAMETEST_VERTEX_INDEX_H
+#define PEBBLEGAMETEST_VERTEX_INDEX_H
+
+#include <cstdint>
+#include <type_traits>
+
+// A lattice of n, s has s^2 (3^(n + 1) - 1) / 2 sites, which is past 2^31 - 1 from n = 14 at s = 18 on, so a build
+// made with -DSG_INDEX64 numbers the sites with 64-bit integers. The lattice builder, the lattice files and every
+// vertex id the engine stores (bonds, the pebble graph, the neighbor table) follow it. Without it they stay 32 bits,
+// which keeps the tables half the size for every lattice that fits
+#ifdef SG_INDEX64
+typedef int64_t vertex_t;
+#else
+typedef int32_t vertex_t;
+#endif
+
+static const vertex_t VERTEX_MAX = INT64_MAX >> (64 - 8 * sizeof(vertex_t));
+
+// compact_vertex<count>::type is the narrowest type that numbers count sites and still has room for the marks below
+// -count the engine uses: 16 bits up to 2^15 - 2 sites, vertex_t past that. An engine of a fixed small lattice keeps
+// its pebble graph in it, so the graph of a few thousand sites sits in the L1 and L2 caches
+template<long long count>
+struct compact_vertex {
+    typedef typename std::conditional<count < INT16_MAX, int16_t, vertex_t>::type type;
+};
+
+// the pebble count, occupation and stress mark of a site are each a byte
+typedef int8_t sitestate_t;
+
+#endif //PEBBLEGAMETEST_VERTEX_INDEX_H
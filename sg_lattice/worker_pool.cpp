@@ -0,0 +1,75 @@
+//
+// A fixed set of threads that an engine keeps and hands the same job to, one call per thread
+//
+
+#include "worker_pool.h"
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(int numworkers)
+{
+    stop();
+    for (int k = 0; k < numworkers; k++) {
+        workers.push_back(std::thread(&WorkerPool::work, this, k, round));
+    }
+}
+
+void WorkerPool::stop()
+{
+    if (workers.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int k = 0; k < workers.size(); k++) {
+        workers[k].join();
+    }
+    workers.clear();
+    stopping = false;
+}
+
+void WorkerPool::run(const std::function<void(int)> &todo)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job = &todo;
+        busy = int(workers.size());
+        round++;
+    }
+    wake.notify_all();
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+// A worker takes each round after done once, and the caller doesn't hand out the next until every worker has
+// finished this one. done is the round when the worker was started, as the first job may come before it gets going
+void WorkerPool::work(int k, long long done)
+{
+    while (true) {
+        const std::function<void(int)> *todo;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this, done] { return stopping || round != done; });
+            if (stopping) {
+                return;
+            }
+            done = round;
+            todo = job;
+        }
+        (*todo)(k);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            busy--;
+            if (busy == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,38 @@
+//
+// A fixed set of threads that an engine keeps and hands the same job to, one call per thread
+//
+
+#ifndef PEBBLEGAMETEST_WORKER_POOL_H
+#define PEBBLEGAMETEST_WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// WorkerPool starts its threads once and keeps them waiting between jobs, so a job costs a wake up and a wait
+// rather than starting and joining a thread per part of it. run(job) calls job(k) on worker k for every worker
+// and returns once they have all finished
+class WorkerPool {
+public:
+    ~WorkerPool();
+    void start(int numworkers);             // starts numworkers threads, after stopping any it had
+    void stop();                            // waits for the workers to finish and lets them go
+    int size() const { return int(workers.size()); }
+    void run(const std::function<void(int)> &job);
+
+private:
+    void work(int k, long long done);
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;           // there is a new job, or the workers should stop
+    std::condition_variable finished;       // the last worker busy with the job is done
+    const std::function<void(int)> *job = nullptr;
+    long long round = 0;                    // how many jobs have been handed out
+    int busy = 0;                           // workers that haven't finished the current job
+    bool stopping = false;
+};
+
+#endif //PEBBLEGAMETEST_WORKER_POOL_H
@@ -560,6 +560,7 @@
         numparts = 0; // the number of particles
         rbonds = 0;   // the number of redundant bonds
         SpanLastStatus = 0; // the initial spanning status is NO
+        giantseed = -1;
 
         for (int pcindex = 0; pcindex < size; pcindex++) // Just setting the pebble count to 2 everywhere.
         {                                               // and setting which sites are occupied
@@ -629,9 +630,18 @@
         // choose some densities for the rigid cluster
         if (numparts % check_every == 0 && double(numparts)/size > 0.5)
         {
-            rigidcluster();
-
-            int span = spanningrcluster();
+            int span;
+            if (giant_only) {
+                span = seamrcluster();
+                if (span && SpanLastStatus == 0) {  // make sure it is the giant cluster that spans
+                    rigidcluster();
+                    span = spanningrcluster();
+                }
+            }
+            else {
+                rigidcluster();
+                span = spanningrcluster();
+            }
             log(span);
 
             // choose the critical position to get rigid cluster decomposition
@@ -769,6 +779,111 @@
     }
 
 
+    bool SiteRP::crossesseam(const Bond &b) {
+        int ci = b.vertices.first % ll;
+        int cj = b.vertices.second % ll;
+        return (ci == ll - 1 && cj == 0) || (ci == 0 && cj == ll - 1);
+    }
+
+// A cluster that wraps around the lattice goes through every column, so it holds a bond across the seam, and the
+// giant cluster spans only if seamrcluster finds a cluster that does. A rigid cluster is connected, so each one is
+// grown out from its seam bond over the bonds at its sites, testing them against the seam bond as rigidcluster()
+// does, and the rest of the lattice is never looked at
+    bool SiteRP::seamrcluster() {
+        initgiantrigidcluster();
+
+        std::vector<int> incident[size];    // the bonds at each site
+        std::vector<int> seeds;
+        if (giantseed >= 0 && giantseed < edges.size() && crossesseam(edges[giantseed])) {
+            seeds.push_back(giantseed);
+        }
+        for (int b = 0; b < edges.size(); b++) {
+            incident[edges[b].vertices.first].push_back(b);
+            incident[edges[b].vertices.second].push_back(b);
+            if (crossesseam(edges[b])) {
+                seeds.push_back(b);
+            }
+        }
+
+        int sitecluster[size] = {};
+        std::vector<int> clustersites;
+        std::vector<int> grow;
+        int rcnum = 0;
+        giantindex = 0;
+        giantsize_bond = 0;
+        bool span = false;
+        for (int k = 0; k < seeds.size() && !span; k++) {
+            Bond &refBond = edges[seeds[k]];
+            if (refBond.RigidIndex != 0) {
+                continue;
+            }
+            int rclustersize_bond = 1;
+            rcnum++;
+            refBond.RigidIndex = rcnum;
+            clustersites.clear();
+            clustersites.push_back(refBond.vertices.first);
+            clustersites.push_back(refBond.vertices.second);
+            sitecluster[refBond.vertices.first] = sitecluster[refBond.vertices.second] = rcnum;
+            grow.assign(clustersites.begin(), clustersites.end());
+            while (!grow.empty()) {
+                int i = grow.back();
+                grow.pop_back();
+                for (int m = 0; m < incident[i].size(); m++) {
+                    Bond &testBond = edges[incident[i][m]];
+                    if (testBond.RigidIndex != 0 || !isbondrigid(refBond, testBond)) {
+                        continue;
+                    }
+                    testBond.RigidIndex = rcnum;
+                    rclustersize_bond++;
+                    int j = testBond.vertices.first == i ? testBond.vertices.second : testBond.vertices.first;
+                    if (sitecluster[j] != rcnum) {
+                        sitecluster[j] = rcnum;
+                        clustersites.push_back(j);
+                        grow.push_back(j);
+                    }
+                }
+            }
+
+            // it has to reach every column to wrap. The adjacency is put in the order of edges, as rigidcluster()
+            // leaves it, so that spanningrcluster() walks the cluster the same way
+            if (clustersites.size() >= ll) {
+                for (int i = 0; i <= size - 1; i++) {
+                    giantrigidcluster[i].clear();
+                }
+                for (std::vector<Bond>::iterator it = edges.begin(); it != edges.end(); ++it) {
+                    if (it->RigidIndex == rcnum) {
+                        giantrigidcluster[it->vertices.first].push_back(it->vertices.second);
+                        giantrigidcluster[it->vertices.second].push_back(it->vertices.first);
+                    }
+                }
+                span = spanningrcluster();
+            }
+            if (span || rclustersize_bond >= giantsize_bond) {
+                giantsize_bond = rclustersize_bond;
+                giantindex = rcnum;
+                giantseed = seeds[k];
+            }
+        }
+
+        // leave the largest cluster grown in giantrigidcluster
+        giantsize_site = 0;
+        for (int i = 0; i <= size - 1; i++) {
+            giantrigidcluster[i].clear();
+        }
+        for (std::vector<Bond>::iterator it = edges.begin(); it != edges.end(); ++it) {
+            if (giantindex != 0 && it->RigidIndex == giantindex) {
+                giantrigidcluster[it->vertices.first].push_back(it->vertices.second);
+                giantrigidcluster[it->vertices.second].push_back(it->vertices.first);
+            }
+        }
+        for (int i = 0; i <= size - 1; i++) {
+            if (!giantrigidcluster[i].empty()) {
+                giantsize_site++;
+            }
+        }
+        return span;
+    }
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -5,6 +5,8 @@
 #ifndef PEBBLEGAMETEST_SITERP_H
 #define PEBBLEGAMETEST_SITERP_H
 
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <stack>
 #include <iostream>
@@ -15,9 +17,11 @@ class SiteRP {
     static const int ll = 32;;                                                                                    // The number of vertices on a side of the lattice
 private:
     static const int size = ll * ll;                                                                                // The number of vertices in the graph
+    // the site numbers in the pebble graph, 16 bits while they and EMPTY fit, so the graph of a small lattice sits in cache
+    typedef std::conditional<size < INT16_MAX, int16_t, int>::type site_t;
 public:
-    short pc[size];                // Creates the pebble count at each vertex.
-    short occ[size];             // Says whether the site is occupied with a particle
+    int8_t pc[size];                // Creates the pebble count at each vertex.
+    int8_t occ[size];             // Says whether the site is occupied with a particle
 
     int numparts;           // the number of particles (not pebbles) present in the system
     int numbonds;                    // The number of non-redundant bonds (original bonds and crossbraces) in the system
@@ -29,12 +33,14 @@ public:
     int SpanLastStatus;             // the last status of whether to have a spanning rigid cluster
     int flag_for_span_check = 0;
     int tricount = 0; //the number of upwards pointing triangular plates present in the lattice
+    bool giant_only = false;        // check for spanning with seamrcluster(), decomposing the whole lattice only to confirm
+    int giantseed = -1;             // a seam bond of the largest cluster seamrcluster() last grew, -1 if none
 
     std::vector<int> rcluster_site[size];     // Store all the information about rigid cluster decomposition in sites
-    std::vector<int> thegraph[size];        // thegraph is the graph of all loaded edges
-    std::vector<int> rgraph[size];        // rgraph is the graph of redundant bonds that don't take up any edges
+    std::vector<site_t> thegraph[size];        // thegraph is the graph of all loaded edges
+    std::vector<site_t> rgraph[size];        // rgraph is the graph of redundant bonds that don't take up any edges
     std::vector<Bond> edges;             //bonds only contains loaded edges
-    std::vector<int> giantrigidcluster[size];    //giantrigidcluster is the graph for the giant rigid cluster
+    std::vector<site_t> giantrigidcluster[size];    //giantrigidcluster is the graph for the giant rigid cluster
     std::stack<int> placesbeen;            // The list of places been while looking for a pebble
     std::ofstream myfile;                  // The file stream to output the mainly wanted info
     std::ofstream rclusterfile;            // the file stream to output the rigid cluster decomposition info
@@ -219,6 +225,13 @@ public:
     bool isredundant(int i, int j);  //see if the test bond between (i,j) is redundant(dependent)
     bool isbondrigid(Bond &a, Bond &b); //see if the two bonds a and b are rigid to each other
     void rigidcluster(); // mark the rigid clusters
+    // crossesseam is whether b joins the last column (site % ll == ll - 1) to the first, which a rigid cluster has
+    // to do to wrap around the lattice
+    bool crossesseam(const Bond &b);
+    // seamrcluster grows only the rigid clusters that hold a bond across the seam, the one holding giantseed
+    // first, and stops at the first one that spans, which it returns. giantrigidcluster and the giant sizes are
+    // left holding the largest cluster it grew, which need not be the giant cluster of the whole lattice
+    bool seamrcluster();
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////